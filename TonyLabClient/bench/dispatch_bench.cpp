@@ -0,0 +1,123 @@
+/**
+ * @file      dispatch_bench.cpp
+ * @brief     消息类型路由微基准：字符串哈希表 vs 编译期完美哈希
+ *
+ * 不依赖 Qt，单独编译运行：
+ *   g++ -O2 -std=c++17 -I.. dispatch_bench.cpp -o dispatch_bench
+ *   cl /O2 /std:c++17 /EHsc /I.. dispatch_bench.cpp
+ *
+ * 旧路径：每条消息构造 std::string（module/action 形式还要拼接），再查 unordered_map<std::string, ...>
+ * 新路径：直接引用 json 内部字符串查 MessageTypes 完美哈希表
+ */
+
+#include "network/messagetypes.h"
+#include "third_party/nlohmann_json/include/nlohmann/json.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using json = nlohmann::json;
+
+static std::atomic<std::size_t> g_allocations{0};
+
+void* operator new(std::size_t size)
+{
+    ++g_allocations;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+    constexpr int kIterations = 2000000;
+
+    std::vector<json> makeMessages()
+    {
+        std::vector<json> messages;
+        messages.push_back({{"type", "im.message"}, {"content", "hello"}});
+        messages.push_back({{"type", "im.ack"}, {"messageId", "1"}});
+        messages.push_back({{"type", "contact.status"}, {"contactId", "42"}, {"status", "online"}});
+        messages.push_back({{"type", "heartbeat"}, {"timestamp", 0}});
+        messages.push_back({{"module", "device"}, {"action", "telemetry"}, {"value", 1.5}});
+        messages.push_back({{"module", "group"}, {"action", "update"}});
+        return messages;
+    }
+
+    // 旧实现：与原 MessageDispatcher::dispatch 相同的类型提取与查找方式
+    int legacyLookup(const std::unordered_map<std::string, int>& routes, const json& message)
+    {
+        std::string msgType;
+        if (message.contains("type") && message["type"].is_string()) {
+            msgType = message["type"].get<std::string>();
+        } else if (message.contains("module") && message.contains("action")) {
+            msgType = message["module"].get<std::string>() + "." + message["action"].get<std::string>();
+        }
+        auto it = routes.find(msgType);
+        return it != routes.end() ? it->second : -1;
+    }
+
+    int perfectHashLookup(const json& message)
+    {
+        auto typeIt = message.find("type");
+        if (typeIt != message.end() && typeIt->is_string()) {
+            return MessageTypes::lookup(typeIt->get_ref<const std::string&>());
+        }
+        auto moduleIt = message.find("module");
+        auto actionIt = message.find("action");
+        if (moduleIt != message.end() && actionIt != message.end()) {
+            return MessageTypes::lookup(moduleIt->get_ref<const std::string&>(),
+                                        actionIt->get_ref<const std::string&>());
+        }
+        return -1;
+    }
+
+    template<typename Fn>
+    void run(const char* name, const std::vector<json>& messages, Fn&& fn)
+    {
+        long long checksum = 0;
+        const std::size_t allocBefore = g_allocations.load();
+        const auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < kIterations; ++i) {
+            checksum += fn(messages[static_cast<std::size_t>(i) % messages.size()]);
+        }
+
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        const double ns = std::chrono::duration<double, std::nano>(elapsed).count() / kIterations;
+        const double allocs = static_cast<double>(g_allocations.load() - allocBefore) / kIterations;
+
+        std::printf("%-16s %8.2f ns/msg  %6.2f allocs/msg  (checksum %lld)\n", name, ns, allocs, checksum);
+    }
+}
+
+int main()
+{
+    const std::vector<json> messages = makeMessages();
+
+    std::unordered_map<std::string, int> routes;
+    for (std::uint16_t i = 0; i < MessageTypes::KnownTypeCount; ++i) {
+        routes.emplace(std::string(MessageTypes::kNames[i]), i);
+    }
+
+    run("string map", messages, [&](const json& m) { return legacyLookup(routes, m); });
+    run("perfect hash", messages, [&](const json& m) { return perfectHashLookup(m); });
+    return 0;
+}
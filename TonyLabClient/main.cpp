@@ -4,6 +4,7 @@
 #include "utils/iconhelper.h"
 #include "app/appinit.h"
 #include "modules/login/logindlg.h"
+#include "modules/chat/msgpane.h"
 
 int main(int argc, char *argv[])
 {
@@ -38,6 +39,15 @@ int main(int argc, char *argv[])
         file.close();
     }
 
+    //聊天记录渲染方式：--chat-renderer=native 不创建 QWebEngineView，适合低配置终端
+    for (const QString& arg : a.arguments())
+    {
+        if (arg == QLatin1String("--chat-renderer=native"))
+            MsgPane::setDefaultRenderer(MsgPane::TranscriptRenderer::Native);
+        else if (arg == QLatin1String("--chat-renderer=web"))
+            MsgPane::setDefaultRenderer(MsgPane::TranscriptRenderer::Web);
+    }
+
     AppInit::Instance()->start();
     IconHelper::Load();
 
@@ -2,10 +2,34 @@
 #include "network/WebSocketClient.h"
 #include <QDebug>
 #include <QDateTime>
-#include <QFile>
 #include <QFileInfo>
 #include <QUuid>
 
+namespace
+{
+    constexpr int kReceiptFlushIntervalMs = 500;    // 回执最长延迟
+    constexpr int kReceiptFlushThreshold = 50;      // 积累到该数量立即发出
+
+    // 以下解码器在网络线程执行，只做 json -> 模型转换，不触碰服务状态
+    DecodedModel decodeMessage(const json& data)
+    {
+        return std::make_shared<const Message>(Message::fromWire(data));
+    }
+
+    DecodedModel decodeHistory(const json& data)
+    {
+        auto messages = std::make_shared<QList<Message>>();
+        auto it = data.find("messages");
+        if (it != data.end() && it->is_array()) {
+            messages->reserve(static_cast<int>(it->size()));
+            for (const auto& msgJson : *it) {
+                messages->append(Message::fromWire(msgJson));
+            }
+        }
+        return messages;
+    }
+}
+
 ChatService::ChatService(WebSocketClient* wsClient, QObject* parent)
     : QObject(parent)
     , m_webSocketClient(wsClient)
@@ -15,10 +39,34 @@ ChatService::ChatService(WebSocketClient* wsClient, QObject* parent)
         return;
     }
     
-    // 连接消息接收信号
-    connect(m_webSocketClient, &WebSocketClient::messageReceived,
-            this, &ChatService::onMessageReceived);
+    // 在分发器上注册本服务关心的消息类型
+    registerHandlers();
+    
+    m_transfers = new FileTransferManager(wsClient, this);
+    connect(m_transfers, &FileTransferManager::progress, this, &ChatService::fileTransferProgress);
+    connect(m_transfers, &FileTransferManager::finished, this, [this](const QString& messageId) {
+        // 服务器已收齐，之后重连不再重放
+        m_outbox.retire(messageId);
+        emit messageSent(messageId);
+    });
+    connect(m_transfers, &FileTransferManager::failed, this, [this](const QString& messageId, const QString& error) {
+        // 服务器拒绝或文件不可读，重放也不会成功
+        m_outbox.retire(messageId);
+        emit messageSendFailed(messageId, error);
+    });
+    
+    m_downloads = new FileDownloadManager(wsClient, this);
+    connect(m_downloads, &FileDownloadManager::fileOffered, this, &ChatService::fileOffered);
+    connect(m_downloads, &FileDownloadManager::progress, this, &ChatService::fileDownloadProgress);
+    connect(m_downloads, &FileDownloadManager::finished, this, &ChatService::fileDownloaded);
+    connect(m_downloads, &FileDownloadManager::failed, this, &ChatService::fileDownloadFailed);
+    
+    m_receiptTimer.setSingleShot(true);
+    m_receiptTimer.setInterval(kReceiptFlushIntervalMs);
+    connect(&m_receiptTimer, &QTimer::timeout, this, &ChatService::flushReadReceipts);
     
+    connect(m_webSocketClient, &WebSocketClient::connected,
+            this, &ChatService::onWebSocketConnected);
     connect(m_webSocketClient, &WebSocketClient::disconnected,
             this, &ChatService::onWebSocketDisconnected);
 }
@@ -27,11 +75,66 @@ ChatService::~ChatService()
 {
 }
 
+void ChatService::registerHandlers()
+{
+    m_webSocketClient->setModelDecoder("im.message", decodeMessage);
+    m_webSocketClient->setModelDecoder("im.history", decodeHistory);
+    
+    MessageDispatcher* dispatcher = m_webSocketClient->dispatcher();
+    m_subscriptions.push_back(dispatcher->subscribe("im.message", [this](const json& message) {
+        handleIncomingMessage(message);
+    }));
+    m_subscriptions.push_back(dispatcher->subscribe("im.ack", [this](const json& message) {
+        handleMessageAck(message);
+    }));
+    m_subscriptions.push_back(dispatcher->subscribe("im.typing", [this](const json& message) {
+        handleTypingNotification(message);
+    }));
+    m_subscriptions.push_back(dispatcher->subscribe("im.history", [this](const json& message) {
+        handleHistoryResponse(message);
+    }));
+}
+
 void ChatService::setCurrentUser(const QString& userId, const QString& userName, const QString& avatar)
 {
+    const bool userChanged = m_currentUserId != userId;
     m_currentUserId = userId;
     m_currentUserName = userName;
     m_currentUserAvatar = avatar;
+    
+    // 每个账号一份发件箱，上次退出时未确认的消息在连接可用时重放
+    if (userChanged && !userId.isEmpty()) {
+        m_store.open(userId);
+        m_syncedConversations.clear();
+        m_outbox.open(OutboxStore::defaultPath(userId));
+        m_transfers->openContentIndex(userId);
+        if (m_webSocketClient->isConnected()) {
+            replayOutbox();
+        }
+    }
+}
+
+void ChatService::setCompactMessages(bool enable)
+{
+    m_compactMessages = enable;
+    if (!enable) {
+        m_webSocketClient->setCompactEncoder("im.message", CompactEncoder());
+        return;
+    }
+    
+    // 编码器在网络线程执行，记录的资料只在该线程访问：新连接上或资料变化后的第一条消息带上 sn / sa
+    m_webSocketClient->setCompactEncoder("im.message",
+        [connection = quint64(0), senderId = QString(), name = QString(), avatar = QString()](
+            const json& message, bool binary, quint64 current) mutable {
+            const Message msg = Message::fromJson(message);
+            const bool withProfile = connection != current || senderId != msg.senderId
+                || name != msg.senderName || avatar != msg.senderAvatar;
+            connection = current;
+            senderId = msg.senderId;
+            name = msg.senderName;
+            avatar = msg.senderAvatar;
+            return msg.toCompactJson(binary, withProfile);
+        });
 }
 
 void ChatService::sendTextMessage(const QString& receiverId, const QString& content)
@@ -42,28 +145,12 @@ void ChatService::sendTextMessage(const QString& receiverId, const QString& cont
         return;
     }
     
-    if (!m_webSocketClient->isConnected()) {
-        qWarning() << "WebSocket not connected, message will be sent when connected";
-        // 缓存消息
-        Message msg;
-        msg.id = QUuid::createUuid().toString();
-        msg.senderId = m_currentUserId;
-        msg.senderName = m_currentUserName;
-        msg.senderAvatar = m_currentUserAvatar;
-        msg.receiverId = receiverId;
-        msg.content = content;
-        msg.type = "text";
-        msg.timestamp = QDateTime::currentDateTime();
-        msg.isSent = false;
-        m_pendingMessages.append(msg);
-        return;
-    }
-    
     try {
+        // messageId 在客户端生成，重放时保持不变，服务器据此去重
         json message = {
             {"type", "im.message"},
             {"action", "send"},
-            {"messageId", QUuid::createUuid().toString().toStdString()},
+            {"messageId", QUuid::createUuid().toString(QUuid::WithoutBraces).toStdString()},
             {"senderId", m_currentUserId.toStdString()},
             {"senderName", m_currentUserName.toStdString()},
             {"senderAvatar", m_currentUserAvatar.toStdString()},
@@ -73,8 +160,14 @@ void ChatService::sendTextMessage(const QString& receiverId, const QString& cont
             {"timestamp", QDateTime::currentDateTime().toMSecsSinceEpoch()}
         };
         
-        m_webSocketClient->sendMessage(message);
-        qDebug() << "Message sent to" << receiverId;
+        // 自己发出的消息同样写入本地消息库，切回会话时可以直接显示
+        Message local = Message::fromJson(message);
+        local.type = "text";
+        local.isSent = true;
+        m_store.append(receiverId, local);
+        
+        submitOutbound(json{{"kind", "message"}, {"message", std::move(message)}});
+        qDebug() << "Message queued to" << receiverId;
         
     } catch (const std::exception& e) {
         qCritical() << "Error sending message:" << e.what();
@@ -84,18 +177,9 @@ void ChatService::sendTextMessage(const QString& receiverId, const QString& cont
 
 void ChatService::sendFile(const QString& receiverId, const QString& filePath)
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        emit errorOccurred("Cannot open file: " + filePath);
-        return;
-    }
-    
     QFileInfo fileInfo(filePath);
-    QByteArray fileData = file.readAll();
-    file.close();
-    
-    if (!m_webSocketClient->isConnected()) {
-        emit errorOccurred("WebSocket not connected");
+    if (!fileInfo.isFile() || !fileInfo.isReadable()) {
+        emit errorOccurred("Cannot open file: " + filePath);
         return;
     }
     
@@ -103,67 +187,266 @@ void ChatService::sendFile(const QString& receiverId, const QString& filePath)
         json message = {
             {"type", "im.file"},
             {"action", "send"},
+            {"messageId", QUuid::createUuid().toString(QUuid::WithoutBraces).toStdString()},
             {"senderId", m_currentUserId.toStdString()},
             {"receiverId", receiverId.toStdString()},
             {"fileName", fileInfo.fileName().toStdString()},
-            {"fileSize", fileData.size()},
+            {"fileSize", fileInfo.size()},
             {"timestamp", QDateTime::currentDateTime().toMSecsSinceEpoch()}
         };
         
-        // 先发送文件元数据
-        m_webSocketClient->sendMessage(message);
-        // 然后发送文件内容
-        m_webSocketClient->sendRawData(fileData);
-        
-        qDebug() << "File sent to" << receiverId;
+        // 发件箱只记录路径，文件内容在发送时分块读取
+        submitOutbound(json{
+            {"kind", "file"},
+            {"message", std::move(message)},
+            {"path", fileInfo.absoluteFilePath().toStdString()}
+        });
+        qDebug() << "File queued to" << receiverId;
         
     } catch (const std::exception& e) {
         emit errorOccurred(QString::fromStdString(e.what()));
     }
 }
 
+void ChatService::cancelFile(const QString& messageId)
+{
+    m_transfers->cancel(messageId);
+    m_outbox.retire(messageId);
+}
+
+bool ChatService::downloadFile(const QString& messageId, qint64 fileSize, const QString& targetPath)
+{
+    return m_downloads->download(messageId, fileSize, targetPath);
+}
+
+void ChatService::submitOutbound(const json& entry)
+{
+    const QString id = QString::fromStdString(entry["message"]["messageId"].get<std::string>());
+    m_outbox.append(id, entry);
+    
+    // 未连接时只落盘，连接建立后由 replayOutbox 按顺序发出
+    if (m_webSocketClient->isConnected()) {
+        sendOutboxEntry(entry);
+    }
+}
+
+bool ChatService::sendOutboxEntry(const json& entry)
+{
+    const std::string& kind = entry["kind"].get_ref<const std::string&>();
+    const json& message = entry["message"];
+    
+    if (kind == "file") {
+        // 重放时同一 messageId 的传输会从服务器已确认的位置续传
+        const QString path = QString::fromStdString(entry["path"].get<std::string>());
+        if (!m_transfers->start(message, path)) {
+            // 文件已被删除或移动，重放也不会成功，直接注销
+            const QString id = QString::fromStdString(message["messageId"].get<std::string>());
+            m_outbox.retire(id);
+            emit messageSendFailed(id, "Cannot open file: " + path);
+            return false;
+        }
+        return true;
+    }
+    
+    // 发件箱和发送队列都保存完整格式，启用紧凑格式时由网络线程在写出前转换。
+    // 断线时不在发送队列里保留，重连后由 replayOutbox 统一重放
+    m_webSocketClient->sendReplayableMessage(message);
+    return true;
+}
+
+void ChatService::replayOutbox()
+{
+    const QList<json> entries = m_outbox.pending();
+    if (entries.isEmpty()) {
+        return;
+    }
+    
+    // 发送队列会把连续的消息合并成批量帧，数百条积压只需少量帧
+    qInfo() << "Replaying" << entries.count() << "outbox entries";
+    for (const json& entry : entries) {
+        try {
+            sendOutboxEntry(entry);
+        } catch (const std::exception& e) {
+            qWarning() << "Error replaying outbox entry:" << e.what();
+        }
+    }
+}
+
 void ChatService::fetchMessageHistory(const QString& contactId, int limit)
 {
+    // 本地历史立即可用，切换会话不需要等网络
+    const QList<Message> local = m_store.latest(contactId, limit);
+    if (!local.isEmpty()) {
+        emit historyLoaded(contactId, local);
+    }
+    
+    if (!m_syncedConversations.contains(contactId)) {
+        requestHistoryDelta(contactId, limit);
+    }
+}
+
+void ChatService::fetchOlderMessages(const QString& contactId, const QString& beforeId, int limit)
+{
+    bool hasMoreLocal = false;
+    const QList<Message> local = m_store.before(contactId, beforeId, limit, &hasMoreLocal);
+    if (!local.isEmpty() || hasMoreLocal) {
+        emit olderHistoryLoaded(contactId, local, true);
+        return;
+    }
+    
+    // 本地已经到底，向服务器要更早的一页；同一会话同时只有一个分页请求
+    if (m_olderPageRequests.contains(contactId)) {
+        return;
+    }
+    
+    // 请求不跨连接保留，未连接时直接以空结果结束，界面之后可以再次翻页
     if (!m_webSocketClient->isConnected()) {
-        emit errorOccurred("WebSocket not connected");
+        emit olderHistoryLoaded(contactId, QList<Message>(), true);
         return;
     }
     
     try {
+        const qint64 requestId = m_nextHistoryRequestId++;
         json request = {
             {"type", "im.history"},
             {"action", "fetch"},
+            {"requestId", requestId},
             {"contactId", contactId.toStdString()},
+            {"beforeId", beforeId.toStdString()},
             {"limit", limit}
         };
         
-        m_webSocketClient->sendMessage(request);
-        qDebug() << "Fetching message history for" << contactId;
+        m_webSocketClient->sendReplayableMessage(request);
+        m_historyRequests[requestId] = HistoryRequest{contactId, true, limit};
+        m_olderPageRequests.insert(contactId, requestId);
+        qDebug() << "Fetching older messages for" << contactId << "before" << beforeId;
         
     } catch (const std::exception& e) {
         emit errorOccurred(QString::fromStdString(e.what()));
     }
 }
 
-void ChatService::markMessageAsRead(const QString& messageId)
+void ChatService::requestHistoryDelta(const QString& contactId, int limit)
 {
+    // 未连接时不发，重连后由 onWebSocketConnected 或下次打开会话时再补齐
     if (!m_webSocketClient->isConnected()) {
         return;
     }
     
     try {
-        json message = {
-            {"type", "im.ack"},
-            {"action", "read"},
-            {"messageId", messageId.toStdString()},
-            {"userId", m_currentUserId.toStdString()}
+        const qint64 requestId = m_nextHistoryRequestId++;
+        json request = {
+            {"type", "im.history"},
+            {"action", "fetch"},
+            {"requestId", requestId},
+            {"contactId", contactId.toStdString()},
+            {"limit", limit}
         };
         
-        m_webSocketClient->sendMessage(message);
-        emit messageReadStatusChanged(messageId);
+        // 只要本地最后一条之后的消息
+        const QString lastId = m_store.lastMessageId(contactId);
+        if (!lastId.isEmpty()) {
+            request["afterId"] = lastId.toStdString();
+        }
+        
+        // 断线时尚未写出的请求从发送队列丢弃，与断线时清空的 m_historyRequests 一致，
+        // 旧请求的回复不会在重连后到达并错配到新请求上
+        m_webSocketClient->sendReplayableMessage(request);
+        m_historyRequests[requestId] = HistoryRequest{contactId, false, limit};
+        m_syncedConversations.insert(contactId);
+        qDebug() << "Fetching message history for" << contactId << "after" << lastId;
         
     } catch (const std::exception& e) {
-        qWarning() << "Error marking message as read:" << e.what();
+        emit errorOccurred(QString::fromStdString(e.what()));
+    }
+}
+
+void ChatService::markMessageAsRead(const QString& messageId, const QString& conversationId)
+{
+    queueReadReceipt(conversationId, messageId);
+}
+
+QString ChatService::conversationIdOf(const Message& msg) const
+{
+    // 单聊以对方 ID 作为会话 ID；群聊消息的接收者是群 ID
+    if (msg.senderId == m_currentUserId) {
+        return msg.receiverId;
+    }
+    if (msg.receiverId == m_currentUserId || msg.receiverId.isEmpty()) {
+        return msg.senderId;
+    }
+    return msg.receiverId;
+}
+
+void ChatService::queueReadReceipt(const QString& conversationId, const QString& messageId)
+{
+    if (messageId.isEmpty()) {
+        return;
+    }
+    
+    m_pendingReceipts[conversationId].append(messageId);
+    ++m_pendingReceiptCount;
+    
+    if (m_pendingReceiptCount >= kReceiptFlushThreshold) {
+        flushReadReceipts();
+    } else if (!m_receiptTimer.isActive()) {
+        m_receiptTimer.start();
+    }
+}
+
+void ChatService::setActiveConversation(const QString& conversationId)
+{
+    if (m_activeConversationId == conversationId) {
+        return;
+    }
+    
+    m_activeConversationId = conversationId;
+    if (conversationId.isEmpty()) {
+        return;
+    }
+    
+    // 会话变为可见：积压的未读消息现在才算真正被看到
+    const QStringList unread = m_unreadByConversation.take(conversationId);
+    for (const QString& messageId : unread) {
+        queueReadReceipt(conversationId, messageId);
+    }
+}
+
+void ChatService::flushReadReceipts()
+{
+    m_receiptTimer.stop();
+    if (m_pendingReceipts.isEmpty()) {
+        return;
+    }
+    
+    const QHash<QString, QStringList> receipts = std::move(m_pendingReceipts);
+    m_pendingReceipts.clear();
+    m_pendingReceiptCount = 0;
+    
+    for (auto it = receipts.cbegin(); it != receipts.cend(); ++it) {
+        try {
+            json messageIds = json::array();
+            for (const QString& id : it.value()) {
+                messageIds.push_back(id.toStdString());
+            }
+            
+            json message = {
+                {"type", "im.ack"},
+                {"action", "read"},
+                {"messageIds", std::move(messageIds)},
+                {"userId", m_currentUserId.toStdString()}
+            };
+            if (!it.key().isEmpty()) {
+                message["conversationId"] = it.key().toStdString();
+            }
+            
+            // 断线时由 WebSocketClient 的发送队列暂存到重连
+            m_webSocketClient->sendMessage(message);
+            emit messagesRead(it.key(), it.value());
+            
+        } catch (const std::exception& e) {
+            qWarning() << "Error sending read receipts:" << e.what();
+        }
     }
 }
 
@@ -188,40 +471,30 @@ void ChatService::notifyTyping(const QString& targetId, bool isTyping)
     }
 }
 
-void ChatService::onMessageReceived(const json& message)
+void ChatService::handleIncomingMessage(const json& data)
 {
     try {
-        if (!message.contains("type")) {
-            return;
-        }
-        
-        std::string msgType = message["type"];
+        // 优先使用网络线程预解码的模型
+        auto decoded = m_webSocketClient->dispatcher()->currentModel<Message>();
+        Message msg = decoded ? *decoded : Message::fromWire(data);
+        resolveSender(msg);
         
-        if (msgType == "im.message") {
-            handleIncomingMessage(message);
-        } else if (msgType == "im.ack") {
-            handleMessageAck(message);
-        } else if (msgType == "im.typing") {
-            handleTypingNotification(message);
-        } else if (msgType == "im.history") {
-            handleHistoryResponse(message);
+        // 重放或重复投递的消息只处理一次
+        const QString conversationId = conversationIdOf(msg);
+        if (m_store.isOpen() && !m_store.append(conversationId, msg)
+            && m_store.contains(conversationId, msg.id)) {
+            return;
         }
-        
-    } catch (const std::exception& e) {
-        qWarning() << "Error processing message:" << e.what();
-        emit errorOccurred(QString::fromStdString(e.what()));
-    }
-}
-
-void ChatService::handleIncomingMessage(const json& data)
-{
-    try {
-        Message msg = Message::fromJson(data);
-        m_messages.append(msg);
         emit messageReceived(msg);
         
-        // 自动标记为已读
-        markMessageAsRead(msg.id);
+        // 只有当前可见会话的消息才回执已读，其余等会话被打开时再回执
+        if (msg.senderId != m_currentUserId) {
+            if (!conversationId.isEmpty() && conversationId == m_activeConversationId) {
+                queueReadReceipt(conversationId, msg.id);
+            } else {
+                m_unreadByConversation[conversationId].append(msg.id);
+            }
+        }
         
         qDebug() << "Message received from" << msg.senderName;
         
@@ -233,9 +506,33 @@ void ChatService::handleIncomingMessage(const json& data)
 void ChatService::handleMessageAck(const json& data)
 {
     try {
-        if (data.contains("messageId")) {
-            QString messageId = QString::fromStdString(data["messageId"]);
-            emit messageSent(messageId);
+        QStringList messageIds;
+        const QString messageId = data.contains("messageId") ? jsonString(data, "messageId") : readCompactMessageId(data);
+        if (!messageId.isEmpty()) {
+            messageIds.append(messageId);
+        }
+        
+        // 聚合回执：{"messageIds": [...]}
+        auto idsIt = data.find("messageIds");
+        if (idsIt != data.end() && idsIt->is_array()) {
+            for (const auto& id : *idsIt) {
+                if (id.is_string()) {
+                    messageIds.append(QString::fromStdString(id.get_ref<const std::string&>()));
+                }
+            }
+        }
+        
+        // 对方的已读回执只更新已读状态；服务器的发送确认才从发件箱注销
+        if (data.value("action", "") == "read") {
+            for (const QString& id : qAsConst(messageIds)) {
+                emit messageReadStatusChanged(id);
+            }
+            return;
+        }
+        
+        for (const QString& id : qAsConst(messageIds)) {
+            m_outbox.retire(id);
+            emit messageSent(id);
         }
     } catch (const std::exception& e) {
         qWarning() << "Error handling message ack:" << e.what();
@@ -258,25 +555,102 @@ void ChatService::handleTypingNotification(const json& data)
 void ChatService::handleHistoryResponse(const json& data)
 {
     try {
-        QList<Message> historyMessages;
+        // 按 requestId 找回请求的会话和类型，回复里的其他字段不可靠（空页可能什么都不带）
+        auto requestIt = m_historyRequests.end();
+        auto idIt = data.find("requestId");
+        if (idIt != data.end() && idIt->is_number_integer()) {
+            requestIt = m_historyRequests.find(idIt->get<qint64>());
+        } else {
+            requestIt = m_historyRequests.begin();
+        }
+        if (requestIt == m_historyRequests.end()) {
+            qWarning() << "Ignoring unsolicited history response";
+            return;
+        }
+        const HistoryRequest request = requestIt->second;
+        m_historyRequests.erase(requestIt);
         
-        if (data.contains("messages") && data["messages"].is_array()) {
-            for (const auto& msgJson : data["messages"]) {
-                Message msg = Message::fromJson(msgJson);
+        auto decoded = m_webSocketClient->dispatcher()->currentModel<QList<Message>>();
+        if (!decoded) {
+            decoded = std::static_pointer_cast<const QList<Message>>(decodeHistory(data));
+        }
+        
+        // 本地已有的消息已经显示过，只把新增部分交给界面
+        QList<Message> historyMessages;
+        for (Message msg : *decoded) {
+            resolveSender(msg);
+            if (!m_store.isOpen() || m_store.append(conversationIdOf(msg), msg)) {
                 historyMessages.append(msg);
-                m_messages.append(msg);
             }
         }
         
-        emit historyLoaded(historyMessages);
-        qDebug() << "Loaded" << historyMessages.count() << "messages from history";
+        // beforeId 分页的回复插到界面顶部，其余（首次加载 / afterId 增量）追加到底部
+        if (request.older) {
+            m_olderPageRequests.remove(request.conversationId);
+            emit olderHistoryLoaded(request.conversationId, historyMessages, decoded->count() >= request.limit);
+        } else if (!historyMessages.isEmpty()) {
+            emit historyLoaded(request.conversationId, historyMessages);
+        }
+        qDebug() << "Loaded" << historyMessages.count() << "new messages from history";
         
     } catch (const std::exception& e) {
         qWarning() << "Error handling history response:" << e.what();
     }
 }
 
+void ChatService::resolveSender(Message& msg)
+{
+    if (msg.senderId.isEmpty()) {
+        return;
+    }
+    
+    // 消息自带资料（完整格式或资料变化后的紧凑消息）时记下，之后的紧凑消息沿用
+    if (!msg.senderName.isEmpty() || !msg.senderAvatar.isEmpty()) {
+        m_senderProfiles.insert(msg.senderId, qMakePair(msg.senderName, msg.senderAvatar));
+        return;
+    }
+    
+    if (msg.senderId == m_currentUserId) {
+        msg.senderName = m_currentUserName;
+        msg.senderAvatar = m_currentUserAvatar;
+        return;
+    }
+    
+    auto it = m_senderProfiles.constFind(msg.senderId);
+    if (it != m_senderProfiles.constEnd()) {
+        msg.senderName = it->first;
+        msg.senderAvatar = it->second;
+    } else if (m_profileResolver) {
+        m_profileResolver(msg.senderId, msg.senderName, msg.senderAvatar);
+    }
+}
+
+void ChatService::onWebSocketConnected()
+{
+    if (!m_currentUserId.isEmpty()) {
+        replayOutbox();
+    }
+    
+    // 正在查看的会话补齐断线期间的消息，其余会话等被打开时再补
+    if (!m_activeConversationId.isEmpty()) {
+        requestHistoryDelta(m_activeConversationId, 50);
+    }
+}
+
 void ChatService::onWebSocketDisconnected()
 {
+    // 断线期间可能错过消息，重连后打开会话时重新补齐增量
+    m_syncedConversations.clear();
+    
+    // 未回复的请求不会再有回复（尚未写出的已从发送队列丢弃）；翻页请求以空结果结束，界面才能再次翻页
+    m_historyRequests.clear();
+    const QHash<QString, qint64> olderPages = std::move(m_olderPageRequests);
+    m_olderPageRequests.clear();
+    for (auto it = olderPages.cbegin(); it != olderPages.cend(); ++it) {
+        emit olderHistoryLoaded(it.key(), QList<Message>(), true);
+    }
+    
+    // 待发回执交给发送队列，重连后发出
+    flushReadReceipts();
     qDebug() << "WebSocket disconnected";
 }
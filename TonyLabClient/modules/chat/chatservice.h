@@ -2,9 +2,21 @@
 
 #include <QObject>
 #include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
 #include <QList>
+#include <QTimer>
 #include "third_party/nlohmann_json/include/nlohmann/json.hpp"
 #include "MessageModel.h"
+#include "MessageStore.h"
+#include "OutboxStore.h"
+#include "FileTransferManager.h"
+#include "FileDownloadManager.h"
+#include "network/MessageDispatcher.h"
+#include <functional>
+#include <map>
+#include <vector>
 
 using json = nlohmann::json;
 
@@ -24,43 +36,139 @@ public:
 
     // 消息操作
     void sendTextMessage(const QString& receiverId, const QString& content);
+    /**
+     * @brief 发送文件
+     * 文件经 FileTransferManager 分块发送，内存占用与文件大小无关；断线重连后从服务器已确认的位置续传。
+     * 进度通过 fileTransferProgress 发出
+     */
     void sendFile(const QString& receiverId, const QString& filePath);
+    /// 取消尚未完成的文件发送
+    void cancelFile(const QString& messageId);
+    FileTransferManager* fileTransfers() const { return m_transfers; }
+
+    /**
+     * @brief 下载对方发来的文件（fileOffered 中的 messageId 与大小）
+     * 中断后对同一 messageId 和路径再次调用会从已落盘的部分续传
+     */
+    bool downloadFile(const QString& messageId, qint64 fileSize, const QString& targetPath);
+    FileDownloadManager* fileDownloads() const { return m_downloads; }
+
+    /**
+     * @brief 加载会话历史
+     * 先从本地消息库同步发出 historyLoaded；本次连接内首次打开该会话时，
+     * 再以最后一条本地消息 ID 向服务器请求增量（afterId），增量到达后只发出新增部分
+     */
     void fetchMessageHistory(const QString& contactId, int limit = 50);
-    void markMessageAsRead(const QString& messageId);
+
+    /**
+     * @brief 加载 beforeId 之前的一页历史（向上翻页）
+     * 先从本地消息库取；本地不足一页时以本地最早的消息为游标向服务器请求 beforeId 分页。
+     * 结果通过 olderHistoryLoaded 发出；未连接时和断线时未回复的分页以空结果发出，界面据此结束加载状态
+     */
+    void fetchOlderMessages(const QString& contactId, const QString& beforeId, int limit = 50);
+    void markMessageAsRead(const QString& messageId, const QString& conversationId = QString());
     void notifyTyping(const QString& targetId, bool isTyping);
 
+    /**
+     * @brief 设置当前可见的会话
+     * 只有可见会话的消息会产生已读回执；切换到某个会话时，该会话积压的未读消息一并回执。
+     * 传空字符串表示没有可见会话（聊天面板被隐藏）
+     */
+    void setActiveConversation(const QString& conversationId);
+    QString activeConversation() const { return m_activeConversationId; }
+
+    /// 立即发出所有待发的已读回执
+    void flushReadReceipts();
+
     // 用户信息
     void setCurrentUser(const QString& userId, const QString& userName, const QString& avatar);
     QString getCurrentUserId() const { return m_currentUserId; }
 
-    // 消息列表
-    const QList<Message>& getMessages() const { return m_messages; }
-    void clearMessages() { m_messages.clear(); }
+    /**
+     * @brief 以紧凑格式（Message::toCompactJson）发送 im.message
+     * 在 sys.hello 中声明，服务器确认后才由网络线程在写出时转换，未确认时仍发完整格式；发件箱始终保存完整格式。
+     * 发送者名称 / 头像只在每次连接后和资料变化后的第一条消息中带上。接收总是同时兼容两种格式
+     */
+    void setCompactMessages(bool enable);
+    bool compactMessages() const { return m_compactMessages; }
+
+    /// 按用户 ID 查找名称和头像，找不到返回 false
+    using ProfileResolver = std::function<bool(const QString& userId, QString& name, QString& avatar)>;
+
+    /**
+     * @brief 设置发送者资料的查找函数（通常查好友列表）
+     * 紧凑格式的消息不带发送者资料时用它补全
+     */
+    void setProfileResolver(ProfileResolver resolver) { m_profileResolver = std::move(resolver); }
+
+    // 消息列表（本地消息库）
+    QList<Message> getMessages(const QString& conversationId, int limit = 50) { return m_store.latest(conversationId, limit); }
 
 signals:
     void messageReceived(const Message& message);
     void messageSent(const QString& messageId);
     void messageSendFailed(const QString& messageId, const QString& error);
+    void fileTransferProgress(const QString& messageId, qint64 bytesSent, qint64 totalBytes);
+    void fileOffered(const QString& messageId, const QString& senderId, const QString& fileName, qint64 fileSize);
+    void fileDownloadProgress(const QString& messageId, qint64 bytesReceived, qint64 totalBytes);
+    void fileDownloaded(const QString& messageId, const QString& filePath);
+    void fileDownloadFailed(const QString& messageId, const QString& error);
+    /// 对方已读了自己发出的消息（im.ack，action 为 read）
     void messageReadStatusChanged(const QString& messageId);
-    void historyLoaded(const QList<Message>& messages);
+    void messagesRead(const QString& conversationId, const QStringList& messageIds);
+    void historyLoaded(const QString& conversationId, const QList<Message>& messages);
+    void olderHistoryLoaded(const QString& conversationId, const QList<Message>& messages, bool hasMore);
     void typingStatusChanged(const QString& contactId, bool isTyping);
     void errorOccurred(const QString& errorMsg);
 
 private slots:
-    void onMessageReceived(const json& message);
+    void onWebSocketConnected();
     void onWebSocketDisconnected();
 
 private:
+    void registerHandlers();
     void handleIncomingMessage(const json& data);
     void handleMessageAck(const json& data);
     void handleTypingNotification(const json& data);
     void handleHistoryResponse(const json& data);
+    void submitOutbound(const json& entry);
+    bool sendOutboxEntry(const json& entry);
+    void replayOutbox();
+    QString conversationIdOf(const Message& msg) const;
+    void requestHistoryDelta(const QString& contactId, int limit);
+    void queueReadReceipt(const QString& conversationId, const QString& messageId);
+    void resolveSender(Message& msg);
 
     WebSocketClient* m_webSocketClient = nullptr;
+    std::vector<MessageSubscription> m_subscriptions;
     QString m_currentUserId;
     QString m_currentUserName;
     QString m_currentUserAvatar;
-    QList<Message> m_messages;
-    QList<Message> m_pendingMessages;
+    bool m_compactMessages = false;
+    ProfileResolver m_profileResolver;
+    QHash<QString, QPair<QString, QString>> m_senderProfiles;   // 紧凑消息中带过的资料：ID -> (名称, 头像)
+    MessageStore m_store;       // 按会话索引的本地消息库
+    QSet<QString> m_syncedConversations;    // 本次连接内已与服务器补齐增量的会话
+    // 已发出的 im.history 请求（requestId -> 请求）。服务器回显 requestId；
+    // 没有回显时按发送顺序取最早的一个（同一连接上的回复按序到达）
+    struct HistoryRequest
+    {
+        QString conversationId;
+        bool older = false;     // beforeId 分页；否则为首次加载 / afterId 增量
+        int limit = 0;
+    };
+    std::map<qint64, HistoryRequest> m_historyRequests;
+    QHash<QString, qint64> m_olderPageRequests;     // 正在向服务器请求更早分页的会话 -> requestId
+    qint64 m_nextHistoryRequestId = 1;
+    OutboxStore m_outbox;       // 待服务器确认的发送，断线/退出后可重放
+    FileTransferManager* m_transfers = nullptr;
+    FileDownloadManager* m_downloads = nullptr;
+
+    // 已读回执按会话聚合，定时或达到数量阈值时合并为一条 im.ack 发出
+    QString m_activeConversationId;
+    QHash<QString, QStringList> m_unreadByConversation;     // 不可见会话中尚未回执的消息
+    QHash<QString, QStringList> m_pendingReceipts;          // 等待发出的回执
+    int m_pendingReceiptCount = 0;
+    QTimer m_receiptTimer;
 };
 
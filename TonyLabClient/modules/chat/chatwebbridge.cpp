@@ -0,0 +1,11 @@
+#include "chatwebbridge.h"
+
+ChatWebBridge::ChatWebBridge(QObject* parent)
+    : QObject(parent)
+{
+}
+
+void ChatWebBridge::requestOlderMessages()
+{
+    emit olderMessagesRequested();
+}
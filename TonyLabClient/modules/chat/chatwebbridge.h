@@ -0,0 +1,22 @@
+#pragma once
+
+#include <QObject>
+
+/**
+ * @brief 聊天网页与 C++ 之间的 QWebChannel 桥
+ * 以 "chatBridge" 注册到 MsgPane 的页面，index1.html 在滚动到顶部时调用 requestOlderMessages
+ */
+class ChatWebBridge : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ChatWebBridge(QObject* parent = nullptr);
+
+public slots:
+    /// 网页滚动到顶部，请求更早的一页
+    void requestOlderMessages();
+
+signals:
+    void olderMessagesRequested();
+};
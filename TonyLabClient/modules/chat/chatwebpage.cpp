@@ -0,0 +1,83 @@
+#include "chatwebpage.h"
+#include "chatwebbridge.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QPointer>
+#include <QWebChannel>
+
+namespace
+{
+    const QUrl kChatPageUrl(QStringLiteral("qrc:/html/html/index1.html"));
+
+    QPointer<ChatWebPage>& prewarmedPage()
+    {
+        static QPointer<ChatWebPage> page;
+        return page;
+    }
+}
+
+ChatWebPage::ChatWebPage(QObject* parent)
+    : QWebEnginePage(parent)
+{
+    // 页面滚动到顶部时通过该桥请求更早的一页
+    m_bridge = new ChatWebBridge(this);
+    auto* channel = new QWebChannel(this);
+    channel->registerObject(QStringLiteral("chatBridge"), m_bridge);
+    setWebChannel(channel);
+
+    connect(this, &QWebEnginePage::loadStarted, this, &ChatWebPage::onLoadStarted);
+    connect(this, &QWebEnginePage::loadFinished, this, &ChatWebPage::onLoadFinished);
+
+    load(kChatPageUrl);
+}
+
+void ChatWebPage::runWhenReady(const QString& script)
+{
+    if (m_ready) {
+        runJavaScript(script);
+    } else {
+        m_pendingScripts.append(script);
+    }
+}
+
+void ChatWebPage::onLoadStarted()
+{
+    m_ready = false;
+}
+
+void ChatWebPage::onLoadFinished(bool ok)
+{
+    if (!ok) {
+        qWarning() << "Chat page failed to load:" << url();
+    }
+
+    m_ready = true;
+    const QStringList scripts = m_pendingScripts;
+    m_pendingScripts.clear();
+    for (const QString& script : scripts) {
+        runJavaScript(script);
+    }
+}
+
+void ChatWebPage::prewarm()
+{
+    QPointer<ChatWebPage>& page = prewarmedPage();
+    if (!page) {
+        // 挂在 qApp 下，没人接管时随应用退出释放
+        page = new ChatWebPage(QCoreApplication::instance());
+    }
+}
+
+ChatWebPage* ChatWebPage::takePrewarmed(QObject* parent)
+{
+    QPointer<ChatWebPage>& prewarmed = prewarmedPage();
+    ChatWebPage* page = prewarmed.data();
+    prewarmed.clear();
+
+    if (!page) {
+        return new ChatWebPage(parent);
+    }
+    page->setParent(parent);
+    return page;
+}
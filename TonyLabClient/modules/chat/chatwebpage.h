@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QStringList>
+#include <QtWebEngineWidgets/QWebEnginePage>
+
+class ChatWebBridge;
+
+/**
+ * @brief 聊天记录网页（index1.html）
+ * 自带 QWebChannel 和 chatBridge。页面加载完成前的 runWhenReady 调用按顺序排队，
+ * loadFinished 后一次执行，不会像直接 runJavaScript 那样被静默丢弃。
+ *
+ * 登录对话框显示期间调用 prewarm() 在后台拉起 WebEngine profile、渲染进程并加载页面，
+ * 登录完成后 MsgPane 通过 takePrewarmed() 接管这个页面，省去主窗口出现前的 WebEngine 冷启动
+ */
+class ChatWebPage : public QWebEnginePage
+{
+    Q_OBJECT
+
+public:
+    explicit ChatWebPage(QObject* parent = nullptr);
+
+    /// 页面加载完成后执行；已加载完成时立即执行
+    void runWhenReady(const QString& script);
+
+    bool isReady() const { return m_ready; }
+
+    ChatWebBridge* bridge() const { return m_bridge; }
+
+    /**
+     * @brief 在后台预先创建并加载聊天页面，重复调用无副作用
+     */
+    static void prewarm();
+
+    /**
+     * @brief 取走预热的页面（没有预热时新建一个），所有权转给 parent
+     */
+    static ChatWebPage* takePrewarmed(QObject* parent);
+
+private slots:
+    void onLoadStarted();
+    void onLoadFinished(bool ok);
+
+private:
+    ChatWebBridge* m_bridge = nullptr;
+    QStringList m_pendingScripts;
+    bool m_ready = false;
+};
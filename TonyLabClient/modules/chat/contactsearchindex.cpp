@@ -0,0 +1,291 @@
+#include "contactsearchindex.h"
+
+#include <QTextCodec>
+#include <algorithm>
+
+namespace
+{
+    // 各字段得分权重（百分比），顺序与 Field 一致
+    constexpr int kFieldWeight[] = {100, 100, 90, 90, 60, 50, 50};
+
+    // GB2312 一级汉字按拼音排序，每个首字母对应一段连续的编码（没有 i/u/v 开头的音节）
+    struct InitialRange
+    {
+        int code;
+        char letter;
+    };
+
+    constexpr InitialRange kInitialRanges[] = {
+        {0xB0A1, 'a'}, {0xB0C5, 'b'}, {0xB2C1, 'c'}, {0xB4EE, 'd'}, {0xB6EA, 'e'},
+        {0xB7A2, 'f'}, {0xB8C1, 'g'}, {0xB9FE, 'h'}, {0xBBF7, 'j'}, {0xBFA6, 'k'},
+        {0xC0AC, 'l'}, {0xC2E8, 'm'}, {0xC4C3, 'n'}, {0xC5B6, 'o'}, {0xC5BE, 'p'},
+        {0xC6DA, 'q'}, {0xC8BB, 'r'}, {0xC8F6, 's'}, {0xCBFA, 't'}, {0xCDDA, 'w'},
+        {0xCEF4, 'x'}, {0xD1B9, 'y'}, {0xD4D1, 'z'}
+    };
+    constexpr int kLevel1End = 0xD7F9;
+
+    // 折叠大小写并去掉空白
+    QString fold(const QString& text)
+    {
+        const QString folded = text.toCaseFolded();
+        QString result;
+        result.reserve(folded.size());
+        for (const QChar ch : folded) {
+            if (!ch.isSpace()) {
+                result.append(ch);
+            }
+        }
+        return result;
+    }
+
+    quint32 gramKey(QChar a, QChar b)
+    {
+        return (static_cast<quint32>(a.unicode()) << 16) | b.unicode();
+    }
+
+    void collectGrams(const QString& term, QVector<quint32>& grams)
+    {
+        for (int i = 0; i + 1 < term.size(); ++i) {
+            grams.append(gramKey(term.at(i), term.at(i + 1)));
+        }
+    }
+
+    void sortUnique(QVector<quint32>& grams)
+    {
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    }
+
+    // query 的字符是否按顺序出现在 term 中；span 返回命中区间的长度
+    bool isSubsequence(const QString& query, const QString& term, int* span)
+    {
+        int first = -1;
+        int pos = 0;
+        for (const QChar ch : query) {
+            pos = term.indexOf(ch, pos);
+            if (pos < 0) {
+                return false;
+            }
+            if (first < 0) {
+                first = pos;
+            }
+            ++pos;
+        }
+        *span = pos - first;
+        return true;
+    }
+}
+
+void ContactSearchIndex::clear()
+{
+    m_slots.clear();
+    m_freeSlots.clear();
+    m_slotById.clear();
+    m_postings.clear();
+}
+
+void ContactSearchIndex::reserve(int size)
+{
+    m_slots.reserve(size);
+    m_slotById.reserve(size);
+}
+
+void ContactSearchIndex::upsert(const Document& document)
+{
+    if (document.id.isEmpty()) {
+        return;
+    }
+    remove(document.id);
+
+    int index;
+    if (!m_freeSlots.isEmpty()) {
+        index = m_freeSlots.takeLast();
+    } else {
+        index = m_slots.size();
+        m_slots.append(Slot());
+    }
+
+    Slot& slot = m_slots[index];
+    slot.id = document.id;
+    slot.alive = true;
+    slot.terms[NameField] = fold(document.name);
+    slot.terms[RemarkField] = fold(document.remark);
+    slot.terms[NameInitialsField] = pinyinInitials(document.name);
+    slot.terms[RemarkInitialsField] = pinyinInitials(document.remark);
+    slot.terms[PartField] = fold(document.part);
+    slot.terms[EmailField] = fold(document.email);
+    slot.terms[IdField] = fold(document.id);
+
+    slot.grams.clear();
+    for (const QString& term : slot.terms) {
+        collectGrams(term, slot.grams);
+    }
+    sortUnique(slot.grams);
+    for (quint32 gram : slot.grams) {
+        m_postings[gram].insert(index);
+    }
+
+    m_slotById.insert(document.id, index);
+}
+
+void ContactSearchIndex::remove(const QString& id)
+{
+    auto it = m_slotById.find(id);
+    if (it == m_slotById.end()) {
+        return;
+    }
+
+    const int index = it.value();
+    m_slotById.erase(it);
+
+    for (quint32 gram : m_slots[index].grams) {
+        auto posting = m_postings.find(gram);
+        if (posting != m_postings.end()) {
+            posting->remove(index);
+            if (posting->isEmpty()) {
+                m_postings.erase(posting);
+            }
+        }
+    }
+
+    m_slots[index] = Slot();
+    m_freeSlots.append(index);
+}
+
+int ContactSearchIndex::score(const Slot& slot, const QString& query, const QVector<quint32>& queryGrams) const
+{
+    int best = 0;
+    for (int field = 0; field < FieldCount; ++field) {
+        const QString& term = slot.terms[field];
+        if (term.size() < query.size()) {
+            continue;
+        }
+
+        int value = 0;
+        int span = 0;
+        if (term == query) {
+            value = 1000;
+        } else if (term.startsWith(query)) {
+            value = 800 - qMin(term.size() - query.size(), 100);    // 越接近完整匹配越靠前
+        } else {
+            const int pos = term.indexOf(query);
+            if (pos >= 0) {
+                value = 600 - qMin(pos, 100);
+            } else if (query.size() > 1 && isSubsequence(query, term, &span)) {
+                value = 400 - qMin(span - query.size(), 100);       // 跳过的字符越少越靠前
+            }
+        }
+        best = qMax(best, value * kFieldWeight[field] / 100);
+    }
+
+    if (best > 0 || queryGrams.size() < 3) {
+        return best;
+    }
+
+    // 错字容忍：与关键字共有至少 2/3 的二元组
+    int hits = 0;
+    for (quint32 gram : queryGrams) {
+        if (std::binary_search(slot.grams.begin(), slot.grams.end(), gram)) {
+            ++hits;
+        }
+    }
+    return hits * 3 >= queryGrams.size() * 2 ? 200 * hits / queryGrams.size() : 0;
+}
+
+QVector<ContactSearchIndex::Match> ContactSearchIndex::search(const QString& query, int limit) const
+{
+    QVector<Match> matches;
+    const QString folded = fold(query);
+    if (folded.isEmpty()) {
+        return matches;
+    }
+
+    QVector<quint32> queryGrams;
+    collectGrams(folded, queryGrams);
+    sortUnique(queryGrams);
+
+    auto consider = [&](int index) {
+        const Slot& slot = m_slots.at(index);
+        const int value = score(slot, folded, queryGrams);
+        if (value > 0) {
+            matches.append({slot.id, value});
+        }
+    };
+
+    if (queryGrams.isEmpty()) {
+        // 单字关键字没有二元组可查，直接扫描
+        for (int index = 0; index < m_slots.size(); ++index) {
+            if (m_slots.at(index).alive) {
+                consider(index);
+            }
+        }
+    } else {
+        // 倒排表取候选：命中的二元组数不少于 2/3（子串、子序列匹配通常都满足）
+        QHash<int, int> hits;
+        for (quint32 gram : queryGrams) {
+            auto posting = m_postings.constFind(gram);
+            if (posting == m_postings.constEnd()) {
+                continue;
+            }
+            for (int index : *posting) {
+                ++hits[index];
+            }
+        }
+
+        const int required = queryGrams.size() - queryGrams.size() / 3;
+        for (auto it = hits.constBegin(); it != hits.constEnd(); ++it) {
+            if (it.value() >= required) {
+                consider(it.key());
+            }
+        }
+    }
+
+    std::sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) {
+        return a.score != b.score ? a.score > b.score : a.id < b.id;
+    });
+    if (limit > 0 && matches.size() > limit) {
+        matches.resize(limit);
+    }
+    return matches;
+}
+
+QString ContactSearchIndex::pinyinInitials(const QString& text)
+{
+    static QTextCodec* codec = QTextCodec::codecForName("GB18030");
+
+    QString result;
+    bool inWord = false;
+    for (const QChar ch : text) {
+        if (ch.unicode() < 0x80) {
+            // 英文单词取首字母
+            if (ch.isLetterOrNumber()) {
+                if (!inWord) {
+                    result.append(ch.toLower());
+                }
+                inWord = true;
+            } else {
+                inWord = false;
+            }
+            continue;
+        }
+
+        inWord = false;
+        if (!codec) {
+            continue;
+        }
+
+        const QByteArray bytes = codec->fromUnicode(QString(ch));
+        if (bytes.size() != 2) {
+            continue;
+        }
+        const int code = (static_cast<uchar>(bytes.at(0)) << 8) | static_cast<uchar>(bytes.at(1));
+        if (code < kInitialRanges[0].code || code > kLevel1End) {
+            continue;
+        }
+
+        const auto range = std::upper_bound(std::begin(kInitialRanges), std::end(kInitialRanges), code,
+            [](int value, const InitialRange& r) { return value < r.code; });
+        result.append(QLatin1Char((range - 1)->letter));
+    }
+    return result;
+}
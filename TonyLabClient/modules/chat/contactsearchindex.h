@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief 联系人搜索索引
+ * 每个联系人的名字、备注、部门、邮箱、ID 以及名字/备注的拼音首字母折叠大小写后建立二元组
+ * (bigram) 倒排索引。查询时用倒排表取候选（允许少量二元组缺失以容忍错字），再按
+ * 完全匹配 > 前缀 > 子串 > 子序列 > 二元组重合度打分排序。
+ * 联系人可单独增删改，不需要整体重建
+ */
+class ContactSearchIndex
+{
+public:
+    struct Document
+    {
+        QString id;
+        QString name;
+        QString remark;
+        QString part;
+        QString email;
+    };
+
+    struct Match
+    {
+        QString id;
+        int score = 0;
+    };
+
+    void clear();
+    void reserve(int size);
+
+    /// 新增或替换一个联系人
+    void upsert(const Document& document);
+
+    void remove(const QString& id);
+
+    bool contains(const QString& id) const { return m_slotById.contains(id); }
+    int size() const { return m_slotById.size(); }
+
+    /**
+     * @brief 搜索
+     * @param query 关键字，不区分大小写，忽略空白
+     * @param limit 最多返回的条数，<= 0 表示不限
+     * @return 按得分从高到低排列的结果
+     */
+    QVector<Match> search(const QString& query, int limit = 0) const;
+
+    /**
+     * @brief 拼音首字母（小写）
+     * 汉字按 GB2312 一级字库的拼音分区取首字母，二级字库和其他字符忽略；英文单词取首字母
+     */
+    static QString pinyinInitials(const QString& text);
+
+private:
+    enum Field
+    {
+        NameField,
+        RemarkField,
+        NameInitialsField,
+        RemarkInitialsField,
+        PartField,
+        EmailField,
+        IdField,
+        FieldCount
+    };
+
+    struct Slot
+    {
+        QString id;
+        QString terms[FieldCount];      // 已折叠大小写
+        QVector<quint32> grams;         // 去重后的二元组，删除时用来清理倒排表
+        bool alive = false;
+    };
+
+    int score(const Slot& slot, const QString& query, const QVector<quint32>& queryGrams) const;
+
+    QVector<Slot> m_slots;
+    QVector<int> m_freeSlots;
+    QHash<QString, int> m_slotById;
+    QHash<quint32, QSet<int>> m_postings;   // 二元组 -> 槽位
+};
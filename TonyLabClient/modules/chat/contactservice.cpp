@@ -2,6 +2,85 @@
 #include "network/WebSocketClient.h"
 #include <QDebug>
 
+namespace
+{
+    constexpr int kStatusFlushIntervalMs = 16;  // 约一帧
+
+    // 以下解码器在网络线程执行，只做 json -> 模型转换，不触碰服务状态
+    template <typename T>
+    QVector<T> parseList(const json& data, const char* key)
+    {
+        QVector<T> items;
+        auto it = data.find(key);
+        if (it != data.end() && it->is_array()) {
+            items.reserve(static_cast<int>(it->size()));
+            for (const auto& itemJson : *it) {
+                items.append(T::fromJson(itemJson));
+            }
+        }
+        return items;
+    }
+
+    template <typename T>
+    DecodedModel decodeList(const json& data, const char* key)
+    {
+        return std::make_shared<QVector<T>>(parseList<T>(data, key));
+    }
+
+    DecodedModel decodeContactList(const json& data)
+    {
+        return decodeList<Contact>(data, "contacts");
+    }
+
+    DecodedModel decodeGroupList(const json& data)
+    {
+        return decodeList<Group>(data, "groups");
+    }
+
+    qint64 jsonVersion(const json& data, const char* key)
+    {
+        auto it = data.find(key);
+        return (it != data.end() && it->is_number_integer()) ? it->get<qint64>() : 0;
+    }
+
+    // contact.delta：{"baseVersion":N,"version":M,"added":[...],"changed":[...],"removed":["id",...]}
+    struct ContactDelta
+    {
+        qint64 baseVersion = 0;
+        qint64 version = 0;
+        QVector<Contact> upserts;       // added 与 changed 合并处理
+        QStringList removed;
+    };
+
+    DecodedModel decodeContactDelta(const json& data)
+    {
+        auto delta = std::make_shared<ContactDelta>();
+        delta->baseVersion = jsonVersion(data, "baseVersion");
+        delta->version = jsonVersion(data, "version");
+        delta->upserts = parseList<Contact>(data, "added");
+        delta->upserts += parseList<Contact>(data, "changed");
+
+        auto it = data.find("removed");
+        if (it != data.end() && it->is_array()) {
+            for (const auto& id : *it) {
+                if (id.is_string()) {
+                    delta->removed.append(QString::fromStdString(id.get<std::string>()));
+                }
+            }
+        }
+        return delta;
+    }
+
+    ContactSearchIndex::Document searchDocument(const Contact& contact)
+    {
+        ContactSearchIndex::Document document;
+        document.id = contact.id;
+        document.name = contact.name;
+        document.remark = contact.remark;
+        return document;
+    }
+}
+
 ContactService::ContactService(WebSocketClient* wsClient, QObject* parent)
     : QObject(parent)
     , m_webSocketClient(wsClient)
@@ -10,15 +89,42 @@ ContactService::ContactService(WebSocketClient* wsClient, QObject* parent)
         qCritical() << "WebSocketClient is null";
         return;
     }
+
+    m_statusFlushTimer.setSingleShot(true);
+    m_statusFlushTimer.setInterval(kStatusFlushIntervalMs);
+    connect(&m_statusFlushTimer, &QTimer::timeout, this, &ContactService::flushStatusChanges);
     
-    connect(m_webSocketClient, &WebSocketClient::messageReceived,
-            this, &ContactService::onMessageReceived);
+    registerHandlers();
 }
 
 ContactService::~ContactService()
 {
 }
 
+void ContactService::registerHandlers()
+{
+    m_webSocketClient->setModelDecoder("contact.list", decodeContactList);
+    m_webSocketClient->setModelDecoder("contact.delta", decodeContactDelta);
+    m_webSocketClient->setModelDecoder("group.list", decodeGroupList);
+    
+    MessageDispatcher* dispatcher = m_webSocketClient->dispatcher();
+    m_subscriptions.push_back(dispatcher->subscribe("contact.list", [this](const json& message) {
+        handleContactListResponse(message);
+    }));
+    m_subscriptions.push_back(dispatcher->subscribe("contact.delta", [this](const json& message) {
+        handleContactDelta(message);
+    }));
+    m_subscriptions.push_back(dispatcher->subscribe("contact.status", [this](const json& message) {
+        handleStatusUpdate(message);
+    }));
+    m_subscriptions.push_back(dispatcher->subscribe("group.list", [this](const json& message) {
+        handleGroupListResponse(message);
+    }));
+    m_subscriptions.push_back(dispatcher->subscribe("group.update", [this](const json& message) {
+        handleGroupUpdate(message);
+    }));
+}
+
 void ContactService::requestContactList()
 {
     if (!m_webSocketClient->isConnected()) {
@@ -31,9 +137,13 @@ void ContactService::requestContactList()
             {"type", "contact.list"},
             {"action", "fetch"}
         };
+        // 已有本地版本时只要增量，服务器回复 contact.delta（版本过旧时也可直接回复全量 contact.list）
+        if (m_contactVersion > 0) {
+            request["sinceVersion"] = m_contactVersion;
+        }
         
         m_webSocketClient->sendMessage(request);
-        qDebug() << "Requesting contact list";
+        qDebug() << "Requesting contact list since version" << m_contactVersion;
         
     } catch (const std::exception& e) {
         emit errorOccurred(QString::fromStdString(e.what()));
@@ -42,12 +152,12 @@ void ContactService::requestContactList()
 
 Contact* ContactService::getContact(const QString& contactId)
 {
-    for (auto& contact : m_contacts) {
-        if (contact.id == contactId) {
-            return &contact;
-        }
-    }
-    return nullptr;
+    return m_contacts.find(contactId);
+}
+
+Group* ContactService::getGroup(const QString& groupId)
+{
+    return m_groups.find(groupId);
 }
 
 void ContactService::addContact(const QString& userId)
@@ -88,14 +198,7 @@ void ContactService::removeContact(const QString& contactId)
         m_webSocketClient->sendMessage(request);
         
         // 本地移除
-        for (int i = 0; i < m_contacts.size(); ++i) {
-            if (m_contacts[i].id == contactId) {
-                m_contacts.removeAt(i);
-                break;
-            }
-        }
-        
-        emit contactRemoved(contactId);
+        removeLocalContact(contactId);
         
     } catch (const std::exception& e) {
         emit errorOccurred(QString::fromStdString(e.what()));
@@ -114,12 +217,11 @@ void ContactService::updateContactRemark(const QString& contactId, const QString
         
         m_webSocketClient->sendMessage(request);
         
-        // 更新本地
-        for (auto& contact : m_contacts) {
-            if (contact.id == contactId) {
-                contact.remark = remark;
-                break;
-            }
+        // 更新本地，搜索索引只替换这一条
+        if (const Contact* contact = m_contacts.find(contactId)) {
+            Contact updated = *contact;
+            updated.remark = remark;
+            upsertContact(updated);
         }
         
     } catch (const std::exception& e) {
@@ -192,11 +294,9 @@ void ContactService::leaveGroup(const QString& groupId)
         m_webSocketClient->sendMessage(request);
         
         // 本地移除
-        for (int i = 0; i < m_groups.size(); ++i) {
-            if (m_groups[i].id == groupId) {
-                m_groups.removeAt(i);
-                break;
-            }
+        const int row = m_groups.remove(groupId);
+        if (row >= 0) {
+            emit groupRemoved(row, groupId);
         }
         
     } catch (const std::exception& e) {
@@ -231,63 +331,108 @@ void ContactService::inviteToGroup(const QString& groupId, const QStringList& me
     }
 }
 
-QList<Contact> ContactService::searchContacts(const QString& keyword)
+QList<Contact> ContactService::searchContacts(const QString& keyword, int limit)
 {
     QList<Contact> results;
-    QString lowerKeyword = keyword.toLower();
-    
-    for (const auto& contact : m_contacts) {
-        if (contact.name.toLower().contains(lowerKeyword) ||
-            contact.remark.toLower().contains(lowerKeyword) ||
-            contact.id.contains(lowerKeyword)) {
-            results.append(contact);
+    const auto matches = m_searchIndex.search(keyword, limit);
+    results.reserve(matches.size());
+    for (const auto& match : matches) {
+        const int row = m_contacts.rowOf(match.id);
+        if (row >= 0) {
+            results.append(m_contacts.at(row));
         }
     }
-    
     return results;
 }
 
-void ContactService::onMessageReceived(const json& message)
+void ContactService::rebuildSearchIndex()
+{
+    m_searchIndex.clear();
+    m_searchIndex.reserve(m_contacts.size());
+    for (const auto& contact : m_contacts.items()) {
+        m_searchIndex.upsert(searchDocument(contact));
+    }
+}
+
+void ContactService::upsertContact(const Contact& contact)
+{
+    bool inserted = false;
+    const int row = m_contacts.upsert(contact, &inserted);
+    m_searchIndex.upsert(searchDocument(contact));
+
+    if (inserted) {
+        emit contactInserted(row);
+    } else {
+        emit contactChanged(row);
+    }
+}
+
+void ContactService::removeLocalContact(const QString& contactId)
+{
+    const int row = m_contacts.remove(contactId);
+    if (row < 0) {
+        return;
+    }
+
+    m_searchIndex.remove(contactId);
+    m_pendingStatuses.remove(contactId);
+    emit contactRemoved(row, contactId);
+}
+
+void ContactService::handleContactListResponse(const json& data)
 {
     try {
-        if (!message.contains("type")) {
-            return;
+        // 优先使用网络线程预解码的模型
+        auto decoded = m_webSocketClient->dispatcher()->currentModel<QVector<Contact>>();
+        if (!decoded) {
+            decoded = std::static_pointer_cast<const QVector<Contact>>(decodeContactList(data));
         }
+        m_contacts.reset(*decoded);
+        m_contactVersion = jsonVersion(data, "version");
+        // 全量列表自带最新状态，之前登记的变化作废
+        m_pendingStatuses.clear();
+        m_statusFlushTimer.stop();
+        rebuildSearchIndex();
         
-        std::string msgType = message["type"];
+        emit contactsReset();
+        qDebug() << "Contact list updated, total:" << m_contacts.size() << "version:" << m_contactVersion;
         
-        if (msgType == "contact.list") {
-            handleContactListResponse(message);
-        } else if (msgType == "contact.status") {
-            handleStatusUpdate(message);
-        } else if (msgType == "group.list") {
-            handleGroupListResponse(message);
-        } else if (msgType == "group.update") {
-            handleGroupUpdate(message);
-        }
     } catch (const std::exception& e) {
-        qWarning() << "Error processing message:" << e.what();
-        emit errorOccurred(QString::fromStdString(e.what()));
+        qWarning() << "Error handling contact list response:" << e.what();
     }
 }
 
-void ContactService::handleContactListResponse(const json& data)
+void ContactService::handleContactDelta(const json& data)
 {
     try {
-        m_contacts.clear();
-        
-        if (data.contains("contacts") && data["contacts"].is_array()) {
-            for (const auto& contactJson : data["contacts"]) {
-                Contact contact = Contact::fromJson(contactJson);
-                m_contacts.append(contact);
-            }
+        auto decoded = m_webSocketClient->dispatcher()->currentModel<ContactDelta>();
+        if (!decoded) {
+            decoded = std::static_pointer_cast<const ContactDelta>(decodeContactDelta(data));
         }
-        
-        emit contactListUpdated(m_contacts);
-        qDebug() << "Contact list updated, total:" << m_contacts.count();
-        
+        const ContactDelta& delta = *decoded;
+
+        // 基线对不上说明中间漏了增量（或本地还没有全量），改为全量同步
+        if (m_contactVersion == 0 || delta.baseVersion != m_contactVersion) {
+            qWarning() << "Contact delta base" << delta.baseVersion << "does not match local version"
+                       << m_contactVersion << ", requesting full list";
+            m_contactVersion = 0;
+            requestContactList();
+            return;
+        }
+
+        for (const auto& contactId : delta.removed) {
+            removeLocalContact(contactId);
+        }
+        for (const auto& contact : delta.upserts) {
+            upsertContact(contact);
+        }
+        m_contactVersion = delta.version;
+
+        qDebug() << "Contact delta applied: +" << delta.upserts.size() << "-" << delta.removed.size()
+                 << "version:" << m_contactVersion;
+
     } catch (const std::exception& e) {
-        qWarning() << "Error handling contact list response:" << e.what();
+        qWarning() << "Error handling contact delta:" << e.what();
     }
 }
 
@@ -298,35 +443,64 @@ void ContactService::handleStatusUpdate(const json& data)
             QString contactId = QString::fromStdString(data["contactId"]);
             QString status = QString::fromStdString(data["status"]);
             
-            // 更新本地状态
-            for (auto& contact : m_contacts) {
-                if (contact.id == contactId) {
-                    contact.status = status;
-                    break;
+            // 本地状态立即更新（状态不是搜索字段，索引不用动），通知推迟到窗口结束时合并发出
+            Contact* contact = m_contacts.find(contactId);
+            auto pending = m_pendingStatuses.find(contactId);
+            if (pending == m_pendingStatuses.end()) {
+                const QString before = contact ? contact->status : QString();
+                if (contact && before == status) {
+                    return;     // 状态没变的重复推送
                 }
+                pending = m_pendingStatuses.insert(contactId, PendingStatus{before, status});
+            } else {
+                pending->current = status;
+            }
+
+            if (contact) {
+                contact->status = status;
+            }
+            if (!m_statusFlushTimer.isActive()) {
+                m_statusFlushTimer.start();
             }
-            
-            emit contactStatusChanged(contactId, status);
         }
     } catch (const std::exception& e) {
         qWarning() << "Error handling status update:" << e.what();
     }
 }
 
+void ContactService::flushStatusChanges()
+{
+    m_statusFlushTimer.stop();
+    if (m_pendingStatuses.isEmpty()) {
+        return;
+    }
+
+    // 窗口内来回变化（online -> away -> online）的联系人最终没有变化，不通知
+    QHash<QString, QString> changed;
+    changed.reserve(m_pendingStatuses.size());
+    for (auto it = m_pendingStatuses.constBegin(); it != m_pendingStatuses.constEnd(); ++it) {
+        if (it->current != it->before) {
+            changed.insert(it.key(), it->current);
+        }
+    }
+    m_pendingStatuses.clear();
+
+    if (!changed.isEmpty()) {
+        emit contactStatusesChanged(changed);
+    }
+}
+
 void ContactService::handleGroupListResponse(const json& data)
 {
     try {
-        m_groups.clear();
-        
-        if (data.contains("groups") && data["groups"].is_array()) {
-            for (const auto& groupJson : data["groups"]) {
-                Group group = Group::fromJson(groupJson);
-                m_groups.append(group);
-            }
+        auto decoded = m_webSocketClient->dispatcher()->currentModel<QVector<Group>>();
+        if (!decoded) {
+            decoded = std::static_pointer_cast<const QVector<Group>>(decodeGroupList(data));
         }
+        m_groups.reset(*decoded);
         
-        emit groupListUpdated(m_groups);
-        qDebug() << "Group list updated, total:" << m_groups.count();
+        emit groupsReset();
+        qDebug() << "Group list updated, total:" << m_groups.size();
         
     } catch (const std::exception& e) {
         qWarning() << "Error handling group list response:" << e.what();
@@ -347,11 +521,8 @@ void ContactService::handleGroupUpdate(const json& data)
             }
             
             // 更新本地群组成员
-            for (auto& group : m_groups) {
-                if (group.id == groupId) {
-                    group.members = members;
-                    break;
-                }
+            if (Group* group = m_groups.find(groupId)) {
+                group->members = members;
             }
             
             emit groupMembersChanged(groupId, members);
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <QHash>
 #include <QObject>
 #include <QString>
 #include <QStringList>
+#include <QTimer>
 #include <QList>
+#include <QVector>
 #include "third_party/nlohmann_json/include/nlohmann/json.hpp"
 #include "MessageModel.h"
+#include "ContactSearchIndex.h"
+#include "IndexedStore.h"
+#include "network/MessageDispatcher.h"
+#include <vector>
 
 using json = nlohmann::json;
 
@@ -13,7 +20,12 @@ class WebSocketClient;
 
 /**
  * @brief 联系人服务
- * 负责管理联系人列表、在线状态等
+ * 负责管理联系人列表、在线状态等。
+ * 联系人和群组按 ID 哈希索引、按插入顺序保存（行号稳定），变化以行级信号通知。
+ * 联系人列表带版本号：首次全量拉取（contact.list），之后用 sinceVersion 请求增量（contact.delta），
+ * 增量的基线版本与本地不一致时回退为全量同步。
+ * 在线状态（contact.status）先登记为脏数据，每个窗口（默认 16ms，约一帧）合并为一次
+ * contactStatusesChanged；窗口内变化后又变回原状态的联系人不会出现在通知里
  */
 class ContactService : public QObject
 {
@@ -36,29 +48,66 @@ public:
     void inviteToGroup(const QString& groupId, const QStringList& memberIds);
 
     // 查询
-    const QList<Contact>& getContacts() const { return m_contacts; }
+    const QVector<Contact>& getContacts() const { return m_contacts.items(); }
     Contact* getContact(const QString& contactId);
-    const QList<Group>& getGroups() const { return m_groups; }
-    QList<Contact> searchContacts(const QString& keyword);
+    int contactRow(const QString& contactId) const { return m_contacts.rowOf(contactId); }
+    const QVector<Group>& getGroups() const { return m_groups.items(); }
+    Group* getGroup(const QString& groupId);
+    int groupRow(const QString& groupId) const { return m_groups.rowOf(groupId); }
+    /// 本地联系人列表的版本，0 表示尚未全量同步
+    qint64 contactListVersion() const { return m_contactVersion; }
+
+    /// 在线状态合并通知的窗口（毫秒）
+    void setStatusFlushInterval(int msec) { m_statusFlushTimer.setInterval(msec); }
+    int statusFlushInterval() const { return m_statusFlushTimer.interval(); }
+
+    /// 立即发出尚未通知的在线状态变化
+    void flushStatusChanges();
+    /**
+     * @brief 按名字、备注、ID 或拼音首字母搜索联系人，支持错字容忍
+     * @param limit 最多返回的条数，<= 0 表示不限
+     * @return 按匹配程度从高到低排列
+     */
+    QList<Contact> searchContacts(const QString& keyword, int limit = 0);
 
 signals:
-    void contactListUpdated(const QList<Contact>& contacts);
-    void contactStatusChanged(const QString& contactId, const QString& status);
-    void contactRemoved(const QString& contactId);
-    void groupListUpdated(const QList<Group>& groups);
+    // 联系人列表整体替换（全量同步）
+    void contactsReset();
+    // 行级变化：新增的行追加在末尾；删除后其后的行号前移一位
+    void contactInserted(int row);
+    void contactChanged(int row);
+    void contactRemoved(int row, const QString& contactId);
+    // 在线状态按窗口合并通知（联系人 ID -> 新状态），不触发 contactChanged
+    void contactStatusesChanged(const QHash<QString, QString>& statuses);
+
+    void groupsReset();
+    void groupRemoved(int row, const QString& groupId);
     void groupMembersChanged(const QString& groupId, const QStringList& members);
     void errorOccurred(const QString& errorMsg);
 
-private slots:
-    void onMessageReceived(const json& message);
-
 private:
+    void registerHandlers();
     void handleContactListResponse(const json& data);
+    void handleContactDelta(const json& data);
     void handleStatusUpdate(const json& data);
     void handleGroupListResponse(const json& data);
     void handleGroupUpdate(const json& data);
+    void upsertContact(const Contact& contact);
+    void removeLocalContact(const QString& contactId);
+    void rebuildSearchIndex();
 
     WebSocketClient* m_webSocketClient = nullptr;
-    QList<Contact> m_contacts;
-    QList<Group> m_groups;
+    std::vector<MessageSubscription> m_subscriptions;
+    IndexedStore<Contact> m_contacts;
+    ContactSearchIndex m_searchIndex;       // 全量同步时整体建立，之后按条增删改
+    qint64 m_contactVersion = 0;
+
+    struct PendingStatus
+    {
+        QString before;     // 本窗口第一次变化前的状态
+        QString current;
+    };
+    QHash<QString, PendingStatus> m_pendingStatuses;
+    QTimer m_statusFlushTimer;
+    IndexedStore<Group> m_groups;
 };
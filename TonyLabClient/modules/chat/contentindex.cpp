@@ -0,0 +1,298 @@
+#include "ContentIndex.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMultiHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+
+namespace
+{
+    constexpr quint32 kIndexMagic = 0x544C4349;     // "TLCI"
+    constexpr quint16 kIndexVersion = 1;
+    constexpr int kReadBlocks = 64;                 // 计算签名时每次读入的块数
+    constexpr int kMinCopyPercent = 10;             // 可复制部分低于该比例时不用增量
+
+    // rsync 弱校验：a = Σx，b = Σ(n - i)·x，均取低 16 位
+    void weakInit(const uchar* p, int length, quint32& a, quint32& b)
+    {
+        a = 0;
+        b = 0;
+        for (int i = 0; i < length; ++i) {
+            a += p[i];
+            b += static_cast<quint32>(length - i) * p[i];
+        }
+    }
+
+    quint32 weakValue(quint32 a, quint32 b)
+    {
+        return (a & 0xFFFF) | ((b & 0xFFFF) << 16);
+    }
+
+    quint64 strongChecksum(const char* p, int length)
+    {
+        const QByteArray digest = QCryptographicHash::hash(QByteArray::fromRawData(p, length), QCryptographicHash::Md5);
+        quint64 value = 0;
+        memcpy(&value, digest.constData(), sizeof(value));
+        return value;
+    }
+
+    // 读满 size 字节或到文件尾，保证块边界不因短读错位
+    qint64 readFully(QFile& file, char* buffer, qint64 size)
+    {
+        qint64 total = 0;
+        while (total < size) {
+            const qint64 n = file.read(buffer + total, size - total);
+            if (n < 0) {
+                return -1;
+            }
+            if (n == 0) {
+                break;
+            }
+            total += n;
+        }
+        return total;
+    }
+
+    QDataStream& operator<<(QDataStream& out, const FileSignature& sig)
+    {
+        return out << sig.contentHash << sig.size << sig.fileName << sig.sentAt
+                   << static_cast<qint32>(sig.blockSize) << sig.weak << sig.strong;
+    }
+
+    QDataStream& operator>>(QDataStream& in, FileSignature& sig)
+    {
+        qint32 blockSize = 0;
+        in >> sig.contentHash >> sig.size >> sig.fileName >> sig.sentAt >> blockSize >> sig.weak >> sig.strong;
+        sig.blockSize = blockSize;
+        return in;
+    }
+}
+
+bool ContentIndex::open(const QString& userId)
+{
+    close();
+
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QStringLiteral("/uploads");
+    if (!QDir().mkpath(dir)) {
+        qWarning() << "Cannot create upload index directory:" << dir;
+        return false;
+    }
+    m_path = dir + QLatin1Char('/') + userId + QStringLiteral(".idx");
+
+    QFile file(m_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return true;    // 还没有发送过文件
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint16 version = 0;
+    qint32 count = 0;
+    in >> magic >> version >> count;
+    if (magic != kIndexMagic || version != kIndexVersion || count < 0) {
+        qWarning() << "Ignoring incompatible upload index:" << m_path;
+        return true;
+    }
+
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        auto sig = std::make_shared<FileSignature>();
+        in >> *sig;
+        if (in.status() == QDataStream::Ok && sig->weak.size() == sig->strong.size()) {
+            m_entries.insert(sig->contentHash, std::move(sig));
+        }
+    }
+    return true;
+}
+
+void ContentIndex::close()
+{
+    m_entries.clear();
+    m_path.clear();
+}
+
+std::shared_ptr<const FileSignature> ContentIndex::latestByName(const QString& fileName) const
+{
+    std::shared_ptr<const FileSignature> latest;
+    for (const auto& sig : m_entries) {
+        if (sig->fileName == fileName && (!latest || sig->sentAt > latest->sentAt)) {
+            latest = sig;
+        }
+    }
+    return latest;
+}
+
+void ContentIndex::insert(std::shared_ptr<const FileSignature> signature)
+{
+    if (!signature || signature->contentHash.isEmpty()) {
+        return;
+    }
+
+    m_entries.insert(signature->contentHash, std::move(signature));
+    while (m_entries.size() > kMaxEntries) {
+        auto oldest = m_entries.begin();
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+            if ((*it)->sentAt < (*oldest)->sentAt) {
+                oldest = it;
+            }
+        }
+        m_entries.erase(oldest);
+    }
+    save();
+}
+
+void ContentIndex::save()
+{
+    if (m_path.isEmpty()) {
+        return;
+    }
+
+    QSaveFile out(m_path);
+    if (!out.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot save upload index:" << m_path << out.errorString();
+        return;
+    }
+
+    QDataStream stream(&out);
+    stream << kIndexMagic << kIndexVersion << static_cast<qint32>(m_entries.size());
+    for (const auto& sig : qAsConst(m_entries)) {
+        stream << *sig;
+    }
+    if (stream.status() != QDataStream::Ok || !out.commit()) {
+        qWarning() << "Failed to save upload index:" << m_path;
+    }
+}
+
+std::shared_ptr<FileSignature> ContentIndex::computeSignature(const QString& filePath, int blockSize)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+
+    auto sig = std::make_shared<FileSignature>();
+    sig->size = file.size();
+    sig->fileName = QFileInfo(filePath).fileName();
+    sig->blockSize = blockSize;
+    sig->weak.reserve(static_cast<int>(sig->size / blockSize));
+    sig->strong.reserve(static_cast<int>(sig->size / blockSize));
+
+    // 顺序读一遍，内存只占一个缓冲区；SHA-256 与块签名在同一遍中完成
+    QCryptographicHash sha(QCryptographicHash::Sha256);
+    QByteArray buffer(blockSize * kReadBlocks, Qt::Uninitialized);
+    for (;;) {
+        const qint64 n = readFully(file, buffer.data(), buffer.size());
+        if (n < 0) {
+            return nullptr;
+        }
+        if (n == 0) {
+            break;
+        }
+
+        sha.addData(buffer.constData(), static_cast<int>(n));
+        // 末尾不足一块的部分只参与 SHA-256
+        for (qint64 offset = 0; offset + blockSize <= n; offset += blockSize) {
+            const char* block = buffer.constData() + offset;
+            quint32 a = 0;
+            quint32 b = 0;
+            weakInit(reinterpret_cast<const uchar*>(block), blockSize, a, b);
+            sig->weak.append(weakValue(a, b));
+            sig->strong.append(strongChecksum(block, blockSize));
+        }
+        if (n < buffer.size()) {
+            break;
+        }
+    }
+
+    sig->contentHash = sha.result();
+    return sig;
+}
+
+FileDelta ContentIndex::computeDelta(const QString& filePath, const FileSignature& base)
+{
+    FileDelta delta;
+    const int blockSize = base.blockSize;
+    if (blockSize <= 0 || base.weak.isEmpty()) {
+        return delta;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return delta;
+    }
+    const qint64 size = file.size();
+    if (size < blockSize) {
+        return delta;
+    }
+
+    // 滚动扫描需要随机访问整个文件，映射失败（例如 32 位进程中的超大文件）时放弃增量
+    uchar* data = file.map(0, size);
+    if (!data) {
+        qWarning() << "Cannot map file for delta:" << filePath;
+        return delta;
+    }
+
+    QMultiHash<quint32, int> blocksByWeak;
+    blocksByWeak.reserve(base.weak.size());
+    for (int i = 0; i < base.weak.size(); ++i) {
+        blocksByWeak.insert(base.weak.at(i), i);
+    }
+
+    qint64 pos = 0;
+    quint32 a = 0;
+    quint32 b = 0;
+    weakInit(data, blockSize, a, b);
+
+    while (pos + blockSize <= size) {
+        int matched = -1;
+        const quint32 weak = weakValue(a, b);
+        auto it = blocksByWeak.constFind(weak);
+        if (it != blocksByWeak.constEnd()) {
+            // 弱校验命中才计算强校验
+            const quint64 strong = strongChecksum(reinterpret_cast<const char*>(data + pos), blockSize);
+            for (; it != blocksByWeak.constEnd() && it.key() == weak; ++it) {
+                if (base.strong.at(it.value()) == strong) {
+                    matched = it.value();
+                    break;
+                }
+            }
+        }
+
+        if (matched >= 0) {
+            const qint64 baseOffset = static_cast<qint64>(matched) * blockSize;
+            if (!delta.copies.isEmpty() && delta.copies.last().offset + delta.copies.last().length == pos
+                && delta.copies.last().baseOffset + delta.copies.last().length == baseOffset) {
+                delta.copies.last().length += blockSize;
+            } else {
+                delta.copies.append(DeltaCopy{pos, baseOffset, blockSize});
+            }
+            delta.copiedBytes += blockSize;
+
+            pos += blockSize;
+            if (pos + blockSize <= size) {
+                weakInit(data + pos, blockSize, a, b);
+            }
+            continue;
+        }
+
+        // 窗口右移一个字节
+        if (pos + blockSize < size) {
+            const quint32 out = data[pos];
+            const quint32 in = data[pos + blockSize];
+            a = a - out + in;
+            b = b - static_cast<quint32>(blockSize) * out + a;
+        }
+        ++pos;
+    }
+    file.unmap(data);
+
+    if (delta.copiedBytes * 100 < size * kMinCopyPercent) {
+        return FileDelta();
+    }
+    delta.baseHash = base.contentHash;
+    return delta;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <memory>
+
+/**
+ * @brief 文件内容签名
+ * contentHash 是整个文件的 SHA-256；blocks 是按 blockSize 对齐切分的整块的签名
+ * （rsync 式弱校验 + MD5 前 8 字节），用于以后给同名文件的新版本计算增量
+ */
+struct FileSignature
+{
+    QByteArray contentHash;         // 32 字节 SHA-256
+    qint64 size = 0;
+    QString fileName;
+    qint64 sentAt = 0;              // 最近一次发送成功的时间（毫秒）
+    int blockSize = 0;
+    QVector<quint32> weak;          // 每个整块的滚动校验
+    QVector<quint64> strong;        // 每个整块的 MD5 前 8 字节
+};
+
+/// 新文件中可以从基准文件复制的一段
+struct DeltaCopy
+{
+    qint64 offset = 0;              // 在新文件中的偏移
+    qint64 baseOffset = 0;          // 在基准文件中的偏移
+    qint64 length = 0;
+};
+
+/// 相对基准文件的增量：copies 之外的部分需要上传
+struct FileDelta
+{
+    QByteArray baseHash;
+    QVector<DeltaCopy> copies;      // 按 offset 升序、互不重叠
+    qint64 copiedBytes = 0;
+
+    bool isEmpty() const { return copies.isEmpty(); }
+};
+
+/**
+ * @brief 已发送文件的内容索引
+ * 记录本账号发送成功的文件签名（AppDataLocation/uploads/<userId>.idx，最多 kMaxEntries 个，
+ * 超出时淘汰最久未发送的）。发送前先流式计算 SHA-256 交给服务器判断是否已有相同内容；
+ * 内容不同但有同名的旧版本时，以旧版本为基准计算滚动哈希块增量，只上传变化的部分。
+ * 计算函数是无状态的静态函数，可以在工作线程执行
+ */
+class ContentIndex
+{
+public:
+    static constexpr int kDefaultBlockSize = 16 * 1024;
+    static constexpr int kMaxEntries = 64;
+
+    ContentIndex() = default;
+
+    ContentIndex(const ContentIndex&) = delete;
+    ContentIndex& operator=(const ContentIndex&) = delete;
+
+    /// 加载用户的索引文件
+    bool open(const QString& userId);
+    void close();
+
+    std::shared_ptr<const FileSignature> find(const QByteArray& contentHash) const { return m_entries.value(contentHash); }
+
+    /// 同名文件中最近发送的一个，作为增量基准
+    std::shared_ptr<const FileSignature> latestByName(const QString& fileName) const;
+
+    /// 记录一次发送成功并写盘
+    void insert(std::shared_ptr<const FileSignature> signature);
+
+    /**
+     * @brief 流式计算文件签名（整文件 SHA-256 + 块签名），只顺序读一遍
+     * @return 文件不可读时返回 nullptr
+     */
+    static std::shared_ptr<FileSignature> computeSignature(const QString& filePath, int blockSize = kDefaultBlockSize);
+
+    /**
+     * @brief 以 base 为基准计算 filePath 的增量（rsync 滚动哈希）
+     * 可复制的部分太少时返回空增量，直接上传整个文件更划算
+     */
+    static FileDelta computeDelta(const QString& filePath, const FileSignature& base);
+
+private:
+    void save();
+
+    QString m_path;
+    QHash<QByteArray, std::shared_ptr<const FileSignature>> m_entries;
+};
@@ -0,0 +1,444 @@
+#include "FileDownloadManager.h"
+#include "network/WebSocketClient.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QSaveFile>
+
+namespace
+{
+    constexpr int kRangeBlocks = 128;           // 每个区间的块数（64 KB 块时为 8 MB）
+    constexpr int kStreamTimeoutMs = 15000;     // 区间无新分块的超时
+    constexpr int kTimeoutCheckMs = 1000;
+    constexpr int kSaveDelayMs = 1000;          // 位图合并写盘
+    constexpr int kProgressIntervalMs = 100;
+    constexpr quint32 kMapMagic = 0x544C444D;   // "TLDM"
+    constexpr quint16 kMapVersion = 1;
+
+    QString jsonString(const json& data, const char* key)
+    {
+        auto it = data.find(key);
+        return (it != data.end() && it->is_string()) ? QString::fromStdString(it->get<std::string>()) : QString();
+    }
+
+    qint64 jsonInteger(const json& data, const char* key, qint64 fallback)
+    {
+        auto it = data.find(key);
+        return (it != data.end() && it->is_number_integer()) ? it->get<qint64>() : fallback;
+    }
+}
+
+FileDownloadManager::FileDownloadManager(WebSocketClient* wsClient, QObject* parent)
+    : QObject(parent)
+    , m_client(wsClient)
+{
+    m_timeoutTimer.setInterval(kTimeoutCheckMs);
+    connect(&m_timeoutTimer, &QTimer::timeout, this, &FileDownloadManager::checkTimeouts);
+
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(kSaveDelayMs);
+    connect(&m_saveTimer, &QTimer::timeout, this, &FileDownloadManager::saveMaps);
+
+    if (!m_client) {
+        qCritical() << "WebSocketClient is null";
+        return;
+    }
+
+    m_subscriptions.push_back(m_client->dispatcher()->subscribe("im.file", [this](const json& data) {
+        handleControl(data);
+    }));
+    connect(m_client, &WebSocketClient::chunkReceived, this, &FileDownloadManager::onChunkReceived);
+    connect(m_client, &WebSocketClient::connected, this, &FileDownloadManager::onConnected);
+    connect(m_client, &WebSocketClient::disconnected, this, &FileDownloadManager::onDisconnected);
+}
+
+FileDownloadManager::~FileDownloadManager()
+{
+    // 未完成的下载保留 .part 和位图，下次可以续传
+    saveMaps();
+}
+
+QString FileDownloadManager::mapPath(const Download& download)
+{
+    return download.targetPath + QStringLiteral(".part.map");
+}
+
+bool FileDownloadManager::download(const QString& transferId, qint64 fileSize, const QString& targetPath)
+{
+    if (transferId.isEmpty() || fileSize < 0 || !m_client) {
+        return false;
+    }
+    if (m_downloads.contains(transferId)) {
+        return true;
+    }
+
+    auto download = std::make_shared<Download>();
+    download->id = transferId;
+    download->rawId = MessageCodec::transferIdBytes(transferId);
+    download->targetPath = targetPath;
+    download->size = fileSize;
+    download->blockSize = m_blockSize;
+    download->streamLimit = qMin(m_maxStreams, m_offeredStreams.value(transferId, 1));
+
+    const int blockCount = static_cast<int>((fileSize + m_blockSize - 1) / m_blockSize);
+    download->received.resize(blockCount);
+    download->requested.resize(blockCount);
+
+    // 无缓冲打开：每个分块直接 seek + write 落到对应偏移
+    download->file.setFileName(targetPath + QStringLiteral(".part"));
+    if (!download->file.open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+        qWarning() << "Cannot open download file:" << download->file.fileName() << download->file.errorString();
+        return false;
+    }
+
+    if (!loadMap(*download)) {
+        // 没有可用的位图，从头开始：一次分配好整个文件，之后的写入不会扩展文件
+        download->received.fill(false);
+        if (!download->file.resize(fileSize)) {
+            qWarning() << "Cannot preallocate download file:" << download->file.fileName();
+            download->file.close();
+            return false;
+        }
+        download->mapDirty = true;
+    }
+
+    qDebug() << "Downloading" << transferId << "to" << targetPath << ":"
+             << download->receivedBlocks << "/" << blockCount << "blocks present,"
+             << download->streamLimit << "streams";
+
+    m_downloads.insert(transferId, download);
+    m_idByRaw.insert(download->rawId, transferId);
+    m_timeoutTimer.start();
+
+    if (download->receivedBlocks == blockCount) {
+        complete(transferId);
+        return true;
+    }
+    requestRanges(*download);
+    return true;
+}
+
+void FileDownloadManager::cancel(const QString& transferId)
+{
+    std::shared_ptr<Download> download = m_downloads.value(transferId);
+    if (!download) {
+        return;
+    }
+
+    m_client->sendMessage(json{
+        {"type", "im.file"},
+        {"action", "cancel"},
+        {"transferId", transferId.toStdString()}
+    });
+
+    release(transferId);
+    download->file.remove();
+    QFile::remove(mapPath(*download));
+}
+
+void FileDownloadManager::handleControl(const json& data)
+{
+    // offer 里的传输 ID 就是对方的消息 ID
+    QString id = jsonString(data, "transferId");
+    if (id.isEmpty()) {
+        id = jsonString(data, "messageId");
+    }
+    const QString action = jsonString(data, "action");
+
+    // 对方发来的文件：记下服务器允许的并行数，由界面决定是否下载
+    if (action == QLatin1String("send")) {
+        const QString senderId = jsonString(data, "senderId");
+        if (id.isEmpty() || m_downloads.contains(id)) {
+            return;
+        }
+        m_offeredStreams.insert(id, static_cast<int>(qMax<qint64>(1, jsonInteger(data, "maxStreams", 1))));
+        emit fileOffered(id, senderId, jsonString(data, "fileName"), jsonInteger(data, "fileSize", 0));
+        return;
+    }
+
+    if (action == QLatin1String("reject") && m_downloads.contains(id)) {
+        const QString reason = jsonString(data, "reason");
+        fail(id, reason.isEmpty() ? QStringLiteral("Rejected by server") : reason);
+    }
+}
+
+void FileDownloadManager::requestRanges(Download& download)
+{
+    if (!m_client->isConnected()) {
+        return;
+    }
+
+    const int blockCount = download.received.size();
+    int cursor = 0;
+
+    // 每个区间取连续的、既未收到也未请求的块，最多 kRangeBlocks 个
+    while (download.streams.size() < download.streamLimit) {
+        while (cursor < blockCount && (download.received.testBit(cursor) || download.requested.testBit(cursor))) {
+            ++cursor;
+        }
+        if (cursor >= blockCount) {
+            return;
+        }
+
+        Stream stream;
+        stream.firstBlock = cursor;
+        while (cursor < blockCount && stream.blockCount < kRangeBlocks
+               && !download.received.testBit(cursor) && !download.requested.testBit(cursor)) {
+            download.requested.setBit(cursor);
+            ++stream.blockCount;
+            ++cursor;
+        }
+        stream.deadline = QDateTime::currentMSecsSinceEpoch() + kStreamTimeoutMs;
+
+        const qint64 offset = static_cast<qint64>(stream.firstBlock) * download.blockSize;
+        const qint64 length = qMin<qint64>(static_cast<qint64>(stream.blockCount) * download.blockSize,
+                                           download.size - offset);
+        const int streamId = m_nextStreamId++;
+        download.streams.insert(streamId, stream);
+
+        m_client->sendMessage(json{
+            {"type", "im.file"},
+            {"action", "fetch"},
+            {"transferId", download.id.toStdString()},
+            {"streamId", streamId},
+            {"offset", offset},
+            {"length", length},
+            {"chunkSize", download.blockSize}
+        });
+    }
+}
+
+void FileDownloadManager::onChunkReceived(const ChunkHeader& header, const QByteArray& frame)
+{
+    const QString id = m_idByRaw.value(header.transferId);
+    std::shared_ptr<Download> download = m_downloads.value(id);
+    if (!download) {
+        return;
+    }
+
+    const qint64 offset = static_cast<qint64>(header.offset);
+    const int length = frame.size() - MessageCodec::kChunkHeaderSize;
+    if (offset % download->blockSize != 0 || offset >= download->size
+        || length != qMin<qint64>(download->blockSize, download->size - offset)) {
+        qWarning() << "Ignoring misaligned chunk for" << id << "at" << offset << "length" << length;
+        return;
+    }
+
+    const int block = static_cast<int>(offset / download->blockSize);
+    if (download->received.testBit(block)) {
+        return;     // 超时重发的重复块
+    }
+
+    if (!download->file.seek(offset)
+        || download->file.write(frame.constData() + MessageCodec::kChunkHeaderSize, length) != length) {
+        fail(id, QStringLiteral("Cannot write ") + download->file.fileName() + QStringLiteral(": ")
+                 + download->file.errorString());
+        return;
+    }
+
+    download->received.setBit(block);
+    download->requested.clearBit(block);
+    ++download->receivedBlocks;
+    download->mapDirty = true;
+    if (!m_saveTimer.isActive()) {
+        m_saveTimer.start();
+    }
+
+    // 区间内的块收齐后立即请求下一个区间
+    bool rangeDone = false;
+    for (auto it = download->streams.begin(); it != download->streams.end(); ++it) {
+        if (block < it->firstBlock || block >= it->firstBlock + it->blockCount) {
+            continue;
+        }
+        it->deadline = QDateTime::currentMSecsSinceEpoch() + kStreamTimeoutMs;
+
+        bool pending = false;
+        for (int i = it->firstBlock; i < it->firstBlock + it->blockCount && !pending; ++i) {
+            pending = !download->received.testBit(i);
+        }
+        if (!pending) {
+            download->streams.erase(it);
+            rangeDone = true;
+        }
+        break;
+    }
+
+    if (download->receivedBlocks == download->received.size()) {
+        complete(id);
+        return;
+    }
+
+    if (!download->lastProgress.isValid() || download->lastProgress.elapsed() >= kProgressIntervalMs) {
+        download->lastProgress.start();
+        emit progress(id, qMin<qint64>(static_cast<qint64>(download->receivedBlocks) * download->blockSize,
+                                       download->size), download->size);
+    }
+    if (rangeDone) {
+        requestRanges(*download);
+    }
+}
+
+void FileDownloadManager::checkTimeouts()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    for (const auto& download : qAsConst(m_downloads)) {
+        bool released = false;
+        for (auto it = download->streams.begin(); it != download->streams.end();) {
+            if (it->deadline > now) {
+                ++it;
+                continue;
+            }
+
+            // 缺失的块放回待请求状态，随下一次 requestRanges 重新请求
+            for (int i = it->firstBlock; i < it->firstBlock + it->blockCount; ++i) {
+                download->requested.clearBit(i);
+            }
+            qWarning() << "Download" << download->id << "range at block" << it->firstBlock << "timed out";
+            it = download->streams.erase(it);
+            released = true;
+        }
+        if (released) {
+            requestRanges(*download);
+        }
+    }
+}
+
+void FileDownloadManager::onConnected()
+{
+    for (const auto& download : qAsConst(m_downloads)) {
+        requestRanges(*download);
+    }
+}
+
+void FileDownloadManager::onDisconnected()
+{
+    // 在途区间随连接失效，已落盘的块保留
+    for (const auto& download : qAsConst(m_downloads)) {
+        download->streams.clear();
+        download->requested.fill(false);
+    }
+    saveMaps();
+}
+
+bool FileDownloadManager::loadMap(Download& download)
+{
+    QFile mapFile(mapPath(download));
+    if (download.file.size() != download.size || !mapFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&mapFile);
+    quint32 magic = 0;
+    quint16 version = 0;
+    QByteArray rawId;
+    qint64 size = 0;
+    qint32 blockSize = 0;
+    QBitArray received;
+    in >> magic >> version >> rawId >> size >> blockSize >> received;
+
+    // 位图属于另一个传输或分块大小不同时不可用
+    if (in.status() != QDataStream::Ok || magic != kMapMagic || version != kMapVersion
+        || rawId != download.rawId || size != download.size || blockSize != download.blockSize
+        || received.size() != download.received.size()) {
+        qWarning() << "Ignoring stale download map:" << mapFile.fileName();
+        return false;
+    }
+
+    download.received = received;
+    download.receivedBlocks = received.count(true);
+    return true;
+}
+
+void FileDownloadManager::saveMap(Download& download)
+{
+    if (!download.mapDirty) {
+        return;
+    }
+
+    // 分块是无缓冲写入的，位图记录的块已经交给系统，不会先于数据落盘
+    QSaveFile out(mapPath(download));
+    if (!out.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot save download map:" << out.fileName() << out.errorString();
+        return;
+    }
+
+    QDataStream stream(&out);
+    stream << kMapMagic << kMapVersion << download.rawId << download.size
+           << static_cast<qint32>(download.blockSize) << download.received;
+    if (stream.status() == QDataStream::Ok && out.commit()) {
+        download.mapDirty = false;
+    } else {
+        qWarning() << "Failed to save download map:" << out.fileName();
+    }
+}
+
+void FileDownloadManager::saveMaps()
+{
+    m_saveTimer.stop();
+    for (const auto& download : qAsConst(m_downloads)) {
+        saveMap(*download);
+    }
+}
+
+void FileDownloadManager::complete(const QString& transferId)
+{
+    std::shared_ptr<Download> download = m_downloads.value(transferId);
+    if (!download) {
+        return;
+    }
+
+    emit progress(transferId, download->size, download->size);
+    release(transferId);
+
+    // 目标已存在时覆盖（保存路径由调用方选定）
+    if (QFile::exists(download->targetPath)) {
+        QFile::remove(download->targetPath);
+    }
+    if (!download->file.rename(download->targetPath)) {
+        qWarning() << "Cannot move download into place:" << download->targetPath << download->file.errorString();
+        emit failed(transferId, QStringLiteral("Cannot create ") + download->targetPath);
+        return;
+    }
+    QFile::remove(mapPath(*download));
+
+    m_client->sendMessage(json{
+        {"type", "im.file"},
+        {"action", "complete"},
+        {"transferId", transferId.toStdString()}
+    });
+
+    qDebug() << "Download" << transferId << "complete:" << download->targetPath;
+    emit finished(transferId, download->targetPath);
+}
+
+void FileDownloadManager::fail(const QString& transferId, const QString& error)
+{
+    std::shared_ptr<Download> download = m_downloads.value(transferId);
+    if (!download) {
+        return;
+    }
+
+    // 保留 .part 和位图，之后再次 download 可以续传
+    saveMap(*download);
+    release(transferId);
+
+    qWarning() << "Download" << transferId << "failed:" << error;
+    emit failed(transferId, error);
+}
+
+void FileDownloadManager::release(const QString& transferId)
+{
+    std::shared_ptr<Download> download = m_downloads.take(transferId);
+    if (!download) {
+        return;
+    }
+
+    m_idByRaw.remove(download->rawId);
+    m_offeredStreams.remove(transferId);
+    download->file.close();
+
+    if (m_downloads.isEmpty()) {
+        m_timeoutTimer.stop();
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <QBitArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include "third_party/nlohmann_json/include/nlohmann/json.hpp"
+#include "network/MessageCodec.h"
+#include "network/MessageDispatcher.h"
+#include <memory>
+#include <vector>
+
+using json = nlohmann::json;
+
+class WebSocketClient;
+
+/**
+ * @brief 分块文件接收
+ * 收到的 FrameTag::Chunk 分块按偏移直接写入预先分配好大小的 <目标>.part 文件（无缓冲 seek + write，
+ * 内存占用与文件大小无关）。每个块（与分块大小相同）是否已落盘记在位图里，位图定时保存到
+ * <目标>.part.map，中断后再次 download 同一传输时只请求缺失的块。
+ *
+ * 协议（均为 im.file）：
+ * - 服务器转发对方的 {"action":"send",...,"maxStreams":n}，发出 fileOffered；
+ * - 客户端按区间请求 {"action":"fetch","transferId","streamId","offset","length","chunkSize"}，
+ *   同时最多 min(maxStreams, 服务器允许的 maxStreams) 个区间；
+ * - 服务器对每个区间以分块帧回复，{"action":"reject","reason"} 终止下载；
+ * - 全部收齐后发送 {"action":"complete"}，.part 改名为目标文件。
+ * 区间超过 15 秒没有新分块时，其中缺失的块重新请求；断线后重连时从位图续传
+ */
+class FileDownloadManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileDownloadManager(WebSocketClient* wsClient, QObject* parent = nullptr);
+    ~FileDownloadManager() override;
+
+    /// 本端同时请求的区间数上限，实际还受服务器在 offer 中给出的 maxStreams 限制
+    void setMaxStreams(int count) { m_maxStreams = qMax(1, count); }
+    int maxStreams() const { return m_maxStreams; }
+
+    /**
+     * @brief 开始（或续传）下载
+     * @param transferId 传输 ID（即对方的消息 ID）
+     * @param fileSize 文件大小（来自 offer）
+     * @param targetPath 保存路径，下载期间使用 targetPath + ".part"
+     * @return 无法创建或分配 .part 文件时返回 false
+     */
+    bool download(const QString& transferId, qint64 fileSize, const QString& targetPath);
+
+    /// 取消下载并删除 .part 与位图
+    void cancel(const QString& transferId);
+
+    bool contains(const QString& transferId) const { return m_downloads.contains(transferId); }
+
+signals:
+    void fileOffered(const QString& transferId, const QString& senderId, const QString& fileName, qint64 fileSize);
+    /// 已落盘的字节数（限频，完成时一定发出一次）
+    void progress(const QString& transferId, qint64 bytesReceived, qint64 totalBytes);
+    void finished(const QString& transferId, const QString& filePath);
+    void failed(const QString& transferId, const QString& error);
+
+private slots:
+    void onChunkReceived(const ChunkHeader& header, const QByteArray& frame);
+    void onConnected();
+    void onDisconnected();
+    void checkTimeouts();
+    void saveMaps();
+
+private:
+    struct Stream
+    {
+        int firstBlock = 0;
+        int blockCount = 0;
+        qint64 deadline = 0;
+    };
+
+    struct Download
+    {
+        QString id;
+        QByteArray rawId;
+        QString targetPath;
+        QFile file;                 // <targetPath>.part
+        qint64 size = 0;
+        int blockSize = 0;
+        QBitArray received;         // 已落盘的块
+        QBitArray requested;        // 已分配给在途区间的块
+        int receivedBlocks = 0;
+        int streamLimit = 1;
+        QHash<int, Stream> streams; // streamId -> 区间
+        bool mapDirty = false;
+        QElapsedTimer lastProgress;
+    };
+
+    void handleControl(const json& data);
+    void requestRanges(Download& download);
+    bool loadMap(Download& download);
+    void saveMap(Download& download);
+    void complete(const QString& transferId);
+    void fail(const QString& transferId, const QString& error);
+    void release(const QString& transferId);
+    static QString mapPath(const Download& download);
+
+    WebSocketClient* m_client = nullptr;
+    std::vector<MessageSubscription> m_subscriptions;
+
+    QHash<QString, std::shared_ptr<Download>> m_downloads;
+    QHash<QByteArray, QString> m_idByRaw;       // 16 字节传输 ID -> 传输 ID
+    QHash<QString, int> m_offeredStreams;       // offer 中服务器允许的并行区间数
+    int m_nextStreamId = 1;
+    int m_maxStreams = 4;
+    int m_blockSize = 64 * 1024;
+
+    QTimer m_timeoutTimer;
+    QTimer m_saveTimer;
+};
@@ -0,0 +1,412 @@
+#include "FileTransferManager.h"
+#include "network/MessageCodec.h"
+#include "network/WebSocketClient.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QPointer>
+#include <QRunnable>
+#include <QThreadPool>
+#include <algorithm>
+#include <functional>
+
+namespace
+{
+    constexpr int kProgressIntervalMs = 100;    // progress 信号的最小间隔
+
+    QString jsonString(const json& data, const char* key)
+    {
+        auto it = data.find(key);
+        return (it != data.end() && it->is_string()) ? QString::fromStdString(it->get<std::string>()) : QString();
+    }
+
+    qint64 jsonOffset(const json& data)
+    {
+        auto it = data.find("offset");
+        return (it != data.end() && it->is_number_integer()) ? it->get<qint64>() : -1;
+    }
+
+    std::string hashName(const QByteArray& sha256)
+    {
+        return "sha256:" + sha256.toHex().toStdString();
+    }
+
+    // 在线程池中执行一次的任务
+    class AnalyzeJob : public QRunnable
+    {
+    public:
+        explicit AnalyzeJob(std::function<void()> fn) : m_fn(std::move(fn)) {}
+        void run() override { m_fn(); }
+
+    private:
+        std::function<void()> m_fn;
+    };
+}
+
+FileTransferManager::FileTransferManager(WebSocketClient* wsClient, QObject* parent)
+    : QObject(parent)
+    , m_client(wsClient)
+{
+    m_throttleTimer.setSingleShot(true);
+    connect(&m_throttleTimer, &QTimer::timeout, this, &FileTransferManager::pump);
+
+    if (!m_client) {
+        qCritical() << "WebSocketClient is null";
+        return;
+    }
+
+    m_subscriptions.push_back(m_client->dispatcher()->subscribe("im.file", [this](const json& data) {
+        handleControl(data);
+    }));
+    connect(m_client, &WebSocketClient::disconnected, this, &FileTransferManager::onDisconnected);
+    connect(m_client, &WebSocketClient::sendBufferDrained, this, &FileTransferManager::pump);
+}
+
+FileTransferManager::~FileTransferManager()
+{
+}
+
+void FileTransferManager::setBandwidthLimit(qint64 bytesPerSecond)
+{
+    m_bandwidthLimit = qMax<qint64>(0, bytesPerSecond);
+    m_tokens = 0;
+    m_tokenClock.start();
+    pump();
+}
+
+bool FileTransferManager::start(const json& metadata, const QString& filePath)
+{
+    const QString id = jsonString(metadata, "messageId");
+    if (id.isEmpty() || !m_client) {
+        return false;
+    }
+
+    std::shared_ptr<Transfer> transfer = m_transfers.value(id);
+    if (!transfer) {
+        transfer = std::make_shared<Transfer>();
+        transfer->id = id;
+        transfer->rawId = MessageCodec::transferIdBytes(id);
+        transfer->file.setFileName(filePath);
+        if (!transfer->file.open(QIODevice::ReadOnly)) {
+            qWarning() << "Cannot open file for transfer:" << filePath << transfer->file.errorString();
+            return false;
+        }
+        transfer->size = transfer->file.size();
+        transfer->metadata = metadata;
+        m_transfers.insert(id, transfer);
+        m_order.append(id);
+
+        // 内容哈希算好后才发送元数据
+        analyze(*transfer);
+        return true;
+    }
+
+    // 已有的传输（重连后重放）回到已确认的位置，等服务器 accept 给出续传偏移
+    transfer->metadata = metadata;
+    transfer->accepted = false;
+    transfer->nextOffset = transfer->ackedOffset;
+    if (transfer->analyzed) {
+        announce(*transfer);
+    }
+    return true;
+}
+
+void FileTransferManager::analyze(Transfer& transfer)
+{
+    const QString id = transfer.id;
+    const QString path = transfer.file.fileName();
+    std::shared_ptr<const FileSignature> base = m_index.latestByName(QFileInfo(path).fileName());
+    QPointer<FileTransferManager> self(this);
+
+    // 读整个文件，放到线程池中执行；结果回到本对象所在线程
+    QThreadPool::globalInstance()->start(new AnalyzeJob([self, id, path, base]() {
+        std::shared_ptr<FileSignature> signature = ContentIndex::computeSignature(path);
+        FileDelta delta;
+        if (signature && base && base->contentHash != signature->contentHash) {
+            delta = ContentIndex::computeDelta(path, *base);
+        }
+
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [self, id, signature, delta]() {
+            if (self) {
+                self->onAnalyzed(id, signature, delta);
+            }
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void FileTransferManager::onAnalyzed(const QString& transferId, std::shared_ptr<FileSignature> signature, FileDelta delta)
+{
+    std::shared_ptr<Transfer> transfer = m_transfers.value(transferId);
+    if (!transfer) {
+        return;     // 计算期间被取消
+    }
+
+    transfer->analyzed = true;
+    transfer->signature = std::move(signature);
+    transfer->delta = std::move(delta);
+    if (!transfer->delta.isEmpty()) {
+        qDebug() << "File transfer" << transferId << "delta:" << transfer->delta.copiedBytes
+                 << "of" << transfer->size << "bytes reused";
+    }
+    announce(*transfer);
+}
+
+void FileTransferManager::announce(Transfer& transfer)
+{
+    json request = transfer.metadata;
+    request["transferId"] = transfer.id.toStdString();
+    request["fileSize"] = transfer.size;
+    request["chunkSize"] = m_chunkSize;
+    request["checksum"] = "crc32";
+
+    // 哈希计算失败（文件读到一半出错）时照常整体上传
+    if (transfer.signature) {
+        request["contentHash"] = hashName(transfer.signature->contentHash);
+    }
+    if (!transfer.delta.isEmpty()) {
+        json copies = json::array();
+        for (const DeltaCopy& copy : qAsConst(transfer.delta.copies)) {
+            copies.push_back({copy.offset, copy.baseOffset, copy.length});
+        }
+        request["delta"] = {
+            {"baseHash", hashName(transfer.delta.baseHash)},
+            {"copies", std::move(copies)}
+        };
+    }
+    // 断线后由 ChatService 的发件箱重放（再次 start），不让发送队列也补发一次
+    m_client->sendReplayableMessage(request);
+
+    qDebug() << "File transfer" << transfer.id << "announced," << transfer.size << "bytes";
+}
+
+void FileTransferManager::cancel(const QString& transferId)
+{
+    if (!m_transfers.contains(transferId)) {
+        return;
+    }
+
+    m_client->sendMessage(json{
+        {"type", "im.file"},
+        {"action", "cancel"},
+        {"transferId", transferId.toStdString()}
+    });
+    finish(transferId, QStringLiteral("Cancelled"));
+}
+
+void FileTransferManager::handleControl(const json& data)
+{
+    const QString id = jsonString(data, "transferId");
+    std::shared_ptr<Transfer> transfer = m_transfers.value(id);
+    if (!transfer) {
+        return;     // 不是本端发出的传输（例如对方发来的文件）
+    }
+
+    const QString action = jsonString(data, "action");
+    const qint64 offset = qBound<qint64>(-1, jsonOffset(data), transfer->size);
+
+    if (action == QLatin1String("accept")) {
+        // 服务器没有增量的基准文件时改为整体上传
+        auto deltaIt = data.find("delta");
+        if (deltaIt != data.end() && deltaIt->is_boolean() && !deltaIt->get<bool>() && !transfer->delta.isEmpty()) {
+            qInfo() << "File transfer" << id << "delta base unavailable, sending whole file";
+            transfer->delta = FileDelta();
+        }
+
+        // 服务器已有的数据不再发送；已有相同内容时 offset 即文件大小
+        transfer->ackedOffset = qMax<qint64>(0, offset);
+        transfer->nextOffset = transfer->ackedOffset;
+        transfer->accepted = true;
+        qDebug() << "File transfer" << id << "accepted at" << transfer->ackedOffset;
+    } else if (action == QLatin1String("ack")) {
+        if (offset <= transfer->ackedOffset) {
+            return;
+        }
+        transfer->ackedOffset = offset;
+        transfer->nextOffset = qMax(transfer->nextOffset, offset);
+    } else if (action == QLatin1String("nack")) {
+        // CRC 校验失败或乱序：从服务器给出的位置重发
+        if (offset < 0) {
+            return;
+        }
+        qWarning() << "File transfer" << id << "rewinding to" << offset;
+        transfer->ackedOffset = offset;
+        transfer->nextOffset = offset;
+    } else if (action == QLatin1String("reject")) {
+        const QString reason = jsonString(data, "reason");
+        finish(id, reason.isEmpty() ? QStringLiteral("Rejected by server") : reason);
+        return;
+    } else {
+        return;
+    }
+
+    if (transfer->accepted && transfer->ackedOffset >= transfer->size) {
+        reportProgress(*transfer, true);
+        finish(id, QString());
+        return;
+    }
+
+    reportProgress(*transfer, false);
+    pump();
+}
+
+void FileTransferManager::pump()
+{
+    if (!m_client || !m_client->isConnected() || m_client->isSendBufferFull()) {
+        return;
+    }
+
+    refillTokens();
+    const qint64 window = static_cast<qint64>(m_windowChunks) * m_chunkSize;
+
+    // 轮转：每轮每个传输最多发一块，多个文件同时发送时互不饿死
+    bool sent = true;
+    while (sent) {
+        sent = false;
+        const QStringList order = m_order;
+        for (const QString& id : order) {
+            std::shared_ptr<Transfer> transfer = m_transfers.value(id);
+            if (!transfer || !transfer->accepted || transfer->nextOffset >= transfer->size
+                || literalBytes(*transfer, transfer->ackedOffset, transfer->nextOffset) >= window) {
+                continue;
+            }
+
+            if (m_bandwidthLimit > 0 && m_tokens <= 0) {
+                // 等令牌补足这块再继续
+                const qint64 waitMs = (1 - m_tokens) * 1000 / m_bandwidthLimit + 1;
+                m_throttleTimer.start(static_cast<int>(qBound<qint64>(1, waitMs, 1000)));
+                return;
+            }
+
+            if (!sendChunk(*transfer)) {
+                finish(id, QStringLiteral("Cannot read file: ") + transfer->file.fileName());
+                continue;
+            }
+            sent = true;
+        }
+    }
+}
+
+qint64 FileTransferManager::nextLiteral(const Transfer& transfer, qint64 offset, qint64* literalEnd) const
+{
+    const QVector<DeltaCopy>& copies = transfer.delta.copies;
+
+    // 第一段 offset 大于当前位置的 copy；它之前的一段可能覆盖当前位置
+    auto it = std::upper_bound(copies.begin(), copies.end(), offset,
+        [](qint64 value, const DeltaCopy& copy) { return value < copy.offset; });
+    if (it != copies.begin() && (it - 1)->offset + (it - 1)->length > offset) {
+        offset = (it - 1)->offset + (it - 1)->length;
+    }
+    while (it != copies.end() && it->offset <= offset) {
+        offset = qMax(offset, it->offset + it->length);
+        ++it;
+    }
+
+    *literalEnd = it != copies.end() ? it->offset : transfer.size;
+    return qMin(offset, transfer.size);
+}
+
+qint64 FileTransferManager::literalBytes(const Transfer& transfer, qint64 from, qint64 to) const
+{
+    // [from, to) 中需要上传的字节数（去掉 copy 覆盖的部分），用于计算窗口
+    qint64 bytes = qMax<qint64>(0, to - from);
+    for (const DeltaCopy& copy : transfer.delta.copies) {
+        const qint64 overlap = qMin(to, copy.offset + copy.length) - qMax(from, copy.offset);
+        if (overlap > 0) {
+            bytes -= overlap;
+        }
+    }
+    return bytes;
+}
+
+bool FileTransferManager::sendChunk(Transfer& transfer)
+{
+    // 跳过可以从基准文件复制的部分
+    qint64 literalEnd = transfer.size;
+    const qint64 offset = nextLiteral(transfer, transfer.nextOffset, &literalEnd);
+    if (offset >= transfer.size) {
+        transfer.nextOffset = transfer.size;
+        return true;
+    }
+    const int length = static_cast<int>(qMin<qint64>(m_chunkSize, literalEnd - offset));
+
+    // 只映射这一块，大文件不占用地址空间；映射失败时退回普通读取
+    QByteArray frame;
+    if (uchar* mapped = transfer.file.map(offset, length)) {
+        frame = MessageCodec::encodeChunk(transfer.rawId, static_cast<quint64>(offset),
+                                          reinterpret_cast<const char*>(mapped), length);
+        transfer.file.unmap(mapped);
+    } else {
+        if (!transfer.file.seek(offset)) {
+            return false;
+        }
+        const QByteArray data = transfer.file.read(length);
+        if (data.size() != length) {
+            return false;
+        }
+        frame = MessageCodec::encodeChunk(transfer.rawId, static_cast<quint64>(offset), data.constData(), length);
+    }
+
+    m_client->sendBulkData(frame);
+    transfer.nextOffset = offset + length;
+    m_tokens -= length;
+    return true;
+}
+
+void FileTransferManager::refillTokens()
+{
+    if (m_bandwidthLimit <= 0) {
+        return;
+    }
+    if (!m_tokenClock.isValid()) {
+        m_tokenClock.start();
+        return;
+    }
+
+    // 最多积攒 1/4 秒的额度，空闲后不会突发大量分块
+    const qint64 elapsed = m_tokenClock.restart();
+    const qint64 burst = qMax<qint64>(m_bandwidthLimit / 4, m_chunkSize);
+    m_tokens = qMin(burst, m_tokens + elapsed * m_bandwidthLimit / 1000);
+}
+
+void FileTransferManager::reportProgress(Transfer& transfer, bool force)
+{
+    if (!force && transfer.lastProgress.isValid() && transfer.lastProgress.elapsed() < kProgressIntervalMs) {
+        return;
+    }
+    transfer.lastProgress.start();
+    emit progress(transfer.id, transfer.ackedOffset, transfer.size);
+}
+
+void FileTransferManager::onDisconnected()
+{
+    // 在途分块已随连接丢弃，重连后由元数据重放和 accept 决定续传位置
+    for (const auto& transfer : qAsConst(m_transfers)) {
+        transfer->accepted = false;
+        transfer->nextOffset = transfer->ackedOffset;
+    }
+    m_throttleTimer.stop();
+}
+
+void FileTransferManager::finish(const QString& transferId, const QString& error)
+{
+    std::shared_ptr<Transfer> transfer = m_transfers.take(transferId);
+    if (!transfer) {
+        return;
+    }
+    m_order.removeOne(transferId);
+    transfer->file.close();
+
+    if (error.isEmpty()) {
+        // 服务器已有这份内容，以后可以去重或作为同名文件的增量基准
+        if (transfer->signature) {
+            transfer->signature->sentAt = QDateTime::currentMSecsSinceEpoch();
+            m_index.insert(transfer->signature);
+        }
+        qDebug() << "File transfer" << transferId << "complete";
+        emit finished(transferId);
+    } else {
+        qWarning() << "File transfer" << transferId << "failed:" << error;
+        emit failed(transferId, error);
+    }
+}
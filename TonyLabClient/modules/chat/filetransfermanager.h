@@ -0,0 +1,131 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include "third_party/nlohmann_json/include/nlohmann/json.hpp"
+#include "ContentIndex.h"
+#include "network/MessageDispatcher.h"
+#include <memory>
+#include <vector>
+
+using json = nlohmann::json;
+
+class WebSocketClient;
+
+/**
+ * @brief 分块文件发送
+ * 文件按固定大小分块（默认 64 KB，QFile::map 映射后直接编码，不整体读入内存），
+ * 每块以 FrameTag::Chunk 帧发出，带传输 ID、偏移和 CRC-32，走 WebSocketClient 的低优先级队列，
+ * 与聊天消息交错发送。
+ *
+ * 协议（均为 im.file，transferId 即消息 ID）：
+ * - 客户端发送元数据 {"action":"send","transferId",...,"chunkSize","checksum":"crc32"}；
+ * - 服务器回复 {"action":"accept","offset":n}，从 n 开始（续传）发送分块；
+ * - 服务器按块确认 {"action":"ack","offset":n}（n 为已连续收到的字节数），
+ *   CRC 不符时回复 {"action":"nack","offset":n} 从 n 重发，{"action":"reject","reason"} 终止传输。
+ * 每个传输最多有 windowChunks 块未确认。断线后在途分块作废，重连后再次发送元数据，
+ * 由服务器的 accept 决定续传位置。
+ *
+ * 发送前先在线程池中流式计算 SHA-256（元数据中的 "contentHash":"sha256:<hex>"），服务器已有相同内容时
+ * 直接以 offset = fileSize 回复 accept，不上传任何分块。之前发送过同名文件时，以 ContentIndex 中
+ * 旧版本的块签名计算滚动哈希增量，元数据带上
+ * "delta":{"baseHash","copies":[[offset, baseOffset, length],...]}，只上传 copies 之外的部分；
+ * 服务器没有基准文件时在 accept 中回复 "delta": false，改为上传整个文件
+ */
+class FileTransferManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileTransferManager(WebSocketClient* wsClient, QObject* parent = nullptr);
+    ~FileTransferManager() override;
+
+    void setChunkSize(int bytes) { m_chunkSize = qMax(1024, bytes); }
+    int chunkSize() const { return m_chunkSize; }
+
+    /// 每个传输未确认分块的上限
+    void setWindowChunks(int count) { m_windowChunks = qMax(1, count); }
+    int windowChunks() const { return m_windowChunks; }
+
+    /**
+     * @brief 限制分块发送速率（所有传输合计）
+     * @param bytesPerSecond 每秒字节数，<= 0 表示不限（仍然让位于聊天消息）
+     */
+    void setBandwidthLimit(qint64 bytesPerSecond);
+    qint64 bandwidthLimit() const { return m_bandwidthLimit; }
+
+    /**
+     * @brief 开始（或续传）发送
+     * 同一 transferId 再次调用时重新发送元数据，等待服务器给出续传位置
+     * @param metadata im.file 元数据，必须含 messageId
+     * @return 文件无法打开时返回 false
+     */
+    bool start(const json& metadata, const QString& filePath);
+
+    void cancel(const QString& transferId);
+
+    bool contains(const QString& transferId) const { return m_transfers.contains(transferId); }
+
+    /// 加载用户已发送文件的内容索引（去重与增量的基准）
+    void openContentIndex(const QString& userId) { m_index.open(userId); }
+
+signals:
+    /// 服务器已确认的字节数（限频，完成时一定发出一次）
+    void progress(const QString& transferId, qint64 bytesAcked, qint64 totalBytes);
+    void finished(const QString& transferId);
+    void failed(const QString& transferId, const QString& error);
+
+private slots:
+    void pump();
+    void onDisconnected();
+
+private:
+    struct Transfer
+    {
+        QString id;
+        QByteArray rawId;           // 16 字节，写入分块帧头
+        QFile file;
+        qint64 size = 0;
+        qint64 nextOffset = 0;      // 下一块的偏移
+        qint64 ackedOffset = 0;     // 服务器已连续收到的字节数
+        bool accepted = false;      // 已收到 accept，可以发送分块
+        QElapsedTimer lastProgress;
+
+        json metadata;
+        bool analyzed = false;      // 内容哈希与增量已算好，可以发送元数据
+        std::shared_ptr<FileSignature> signature;
+        FileDelta delta;            // copies 覆盖的部分不上传
+    };
+
+    void handleControl(const json& data);
+    void analyze(Transfer& transfer);
+    void onAnalyzed(const QString& transferId, std::shared_ptr<FileSignature> signature, FileDelta delta);
+    void announce(Transfer& transfer);
+    qint64 nextLiteral(const Transfer& transfer, qint64 offset, qint64* literalEnd) const;
+    qint64 literalBytes(const Transfer& transfer, qint64 from, qint64 to) const;
+    bool sendChunk(Transfer& transfer);
+    void reportProgress(Transfer& transfer, bool force);
+    void finish(const QString& transferId, const QString& error);
+    void refillTokens();
+
+    WebSocketClient* m_client = nullptr;
+    std::vector<MessageSubscription> m_subscriptions;
+
+    QHash<QString, std::shared_ptr<Transfer>> m_transfers;
+    QStringList m_order;            // 轮转顺序，每轮每个传输发一块
+    ContentIndex m_index;
+
+    int m_chunkSize = 64 * 1024;
+    int m_windowChunks = 8;
+
+    // 令牌桶限速
+    qint64 m_bandwidthLimit = 0;
+    qint64 m_tokens = 0;
+    QElapsedTimer m_tokenClock;
+    QTimer m_throttleTimer;
+};
@@ -0,0 +1,356 @@
+#include "FriendDetailLoader.h"
+#include "network/WebSocketClient.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+
+namespace
+{
+    constexpr int kBatchTimeoutMs = 10000;      // 在途批次超时，超时的 ID 重新排队
+    constexpr int kMaxAttempts = 3;
+    constexpr int kTimeoutCheckMs = 1000;
+    constexpr int kSaveDelayMs = 1000;          // 缓存合并写盘
+
+    QString detailString(const json& detail, const char* key)
+    {
+        auto it = detail.find(key);
+        return (it != detail.end() && it->is_string()) ? QString::fromStdString(it->get<std::string>()) : QString();
+    }
+
+    int detailId(const json& value)
+    {
+        if (value.is_number_integer()) {
+            return value.get<int>();
+        }
+        if (value.is_object()) {
+            auto it = value.find("id");
+            if (it != value.end() && it->is_number_integer()) {
+                return it->get<int>();
+            }
+        }
+        return 0;
+    }
+}
+
+FriendDetailLoader::FriendDetailLoader(WebSocketClient* wsClient, QObject* parent)
+    : QObject(parent)
+    , m_client(wsClient)
+{
+    m_timeoutTimer.setInterval(kTimeoutCheckMs);
+    connect(&m_timeoutTimer, &QTimer::timeout, this, &FriendDetailLoader::checkTimeouts);
+
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(kSaveDelayMs);
+    connect(&m_saveTimer, &QTimer::timeout, this, &FriendDetailLoader::saveCache);
+
+    if (!m_client) {
+        qCritical() << "WebSocketClient is null";
+        return;
+    }
+
+    m_subscriptions.push_back(m_client->dispatcher()->subscribe("2", [this](const json& response) {
+        handleResponse(response);
+    }));
+    // 断线期间不发请求，重连后继续
+    connect(m_client, &WebSocketClient::connected, this, &FriendDetailLoader::pump);
+}
+
+FriendDetailLoader::~FriendDetailLoader()
+{
+    saveCache();
+}
+
+QString FriendDetailLoader::cachePath() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+        + QStringLiteral("/frienddetails/") + m_userId + QStringLiteral(".json");
+}
+
+void FriendDetailLoader::start(const QString& userId, const QVector<int>& friendIds)
+{
+    saveCache();
+    m_userId = userId;
+    m_queue.clear();
+    m_queued.clear();
+    m_batches.clear();
+    m_batchOfId.clear();
+    m_attempts.clear();
+    loadCache();
+
+    // 先用缓存填充界面，所有好友再按列表顺序向服务器确认（带 etag，未变化的只回 notModified）
+    QVector<FRIENDINFO> cached;
+    for (int id : friendIds) {
+        auto it = m_cache.constFind(id);
+        if (it != m_cache.constEnd()) {
+            cached.append(it->info);
+        }
+        if (!m_queued.contains(id)) {
+            m_queue.push_back(id);
+            m_queued.insert(id);
+        }
+    }
+    if (!cached.isEmpty()) {
+        emit detailsLoaded(cached);
+    }
+
+    qDebug() << "Friend detail loading:" << friendIds.size() << "friends," << cached.size() << "cached";
+    m_timeoutTimer.start();
+    pump();
+}
+
+void FriendDetailLoader::prioritize(const QVector<int>& friendIds)
+{
+    // 倒序逐个移到队首，保持可见顺序
+    for (int i = friendIds.size() - 1; i >= 0; --i) {
+        const int id = friendIds.at(i);
+        if (!m_queued.contains(id)) {
+            continue;
+        }
+        auto it = std::find(m_queue.begin(), m_queue.end(), id);
+        if (it != m_queue.end()) {
+            m_queue.erase(it);
+            m_queue.push_front(id);
+        }
+    }
+}
+
+void FriendDetailLoader::pump()
+{
+    if (!m_client || !m_client->isConnected()) {
+        return;
+    }
+
+    while (m_batches.size() < m_maxInFlight && !m_queue.empty()) {
+        sendBatch();
+    }
+
+    if (isFinished() && m_timeoutTimer.isActive()) {
+        m_timeoutTimer.stop();
+        emit finished();
+    }
+}
+
+void FriendDetailLoader::sendBatch()
+{
+    const int batchId = m_nextBatchId++;
+    Batch& batch = m_batches[batchId];
+    batch.deadline = QDateTime::currentMSecsSinceEpoch() + kBatchTimeoutMs;
+
+    json request;
+    request["type"] = "2";
+    request["requestId"] = batchId;
+    request["friendIds"] = json::array();
+    json etags = json::object();
+
+    while (batch.pending.size() < m_batchSize && !m_queue.empty()) {
+        const int id = m_queue.front();
+        m_queue.pop_front();
+        m_queued.remove(id);
+
+        batch.pending.insert(id);
+        m_batchOfId.insert(id, batchId);
+        request["friendIds"].push_back(id);
+
+        auto cached = m_cache.constFind(id);
+        if (cached != m_cache.constEnd() && !cached->etag.isEmpty()) {
+            etags[std::to_string(id)] = cached->etag.toStdString();
+        }
+    }
+    if (!etags.empty()) {
+        request["etags"] = std::move(etags);
+    }
+
+    m_client->sendMessage(request);
+}
+
+void FriendDetailLoader::handleResponse(const json& response)
+{
+    const json dataObj = response.value("data", json::object());
+    QVector<FRIENDINFO> loaded;
+    int answeredBatch = 0;      // 本次回复涉及的最早批次
+
+    auto settle = [this, &answeredBatch](int id) {
+        const int batchId = m_batchOfId.take(id);
+        auto batchIt = m_batches.find(batchId);
+        if (batchIt != m_batches.end()) {
+            batchIt->pending.remove(id);
+            if (answeredBatch == 0 || batchId < answeredBatch) {
+                answeredBatch = batchId;
+            }
+        }
+    };
+
+    auto detailsIt = dataObj.find("friendDetails");
+    if (detailsIt != dataObj.end() && detailsIt->is_array()) {
+        loaded.reserve(static_cast<int>(detailsIt->size()));
+        for (const auto& detail : *detailsIt) {
+            const int id = detailId(detail);
+            if (id == 0) {
+                continue;
+            }
+
+            CachedDetail& entry = m_cache[id];
+            entry.info.id = id;
+            entry.info.name = detailString(detail, "name");
+            entry.info.part = detailString(detail, "part");
+            entry.info.email = detailString(detail, "email");
+            entry.info.img = detailString(detail, "img");
+            entry.info.sign = detailString(detail, "sign");
+            entry.etag = detailString(detail, "etag");
+            loaded.append(entry.info);
+            m_cacheDirty = true;
+            settle(id);
+        }
+    }
+
+    // 缓存仍然有效的好友，界面已经用缓存填充过
+    auto notModifiedIt = dataObj.find("notModified");
+    if (notModifiedIt != dataObj.end() && notModifiedIt->is_array()) {
+        for (const auto& value : *notModifiedIt) {
+            settle(detailId(value));
+        }
+    }
+
+    // 每个请求恰好有一个回复，批内没有返回的 ID 视为服务器没有详情，不再等待超时重试。
+    // 服务器回显 requestId 时按它结束；旧的 "2" 协议不回显，同一连接上的回复按序到达，
+    // 结束回复涉及的最早批次，什么都没带的回复对应最早的在途批次
+    auto requestIt = response.find("requestId");
+    if (requestIt != response.end() && requestIt->is_number_integer()) {
+        finishBatch(requestIt->get<int>());
+    } else {
+        if (answeredBatch == 0 && !m_batches.isEmpty()) {
+            answeredBatch = *std::min_element(m_batches.keyBegin(), m_batches.keyEnd());
+        }
+        finishBatch(answeredBatch);
+    }
+    for (auto it = m_batches.begin(); it != m_batches.end();) {
+        if (it->pending.isEmpty()) {
+            it = m_batches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (!loaded.isEmpty()) {
+        emit detailsLoaded(loaded);
+    }
+    if (m_cacheDirty && !m_saveTimer.isActive()) {
+        m_saveTimer.start();
+    }
+    pump();
+}
+
+void FriendDetailLoader::finishBatch(int batchId)
+{
+    auto it = m_batches.find(batchId);
+    if (it == m_batches.end()) {
+        return;
+    }
+    for (int id : it->pending) {
+        m_batchOfId.remove(id);
+    }
+    m_batches.erase(it);
+}
+
+void FriendDetailLoader::checkTimeouts()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    bool released = false;
+
+    for (auto it = m_batches.begin(); it != m_batches.end();) {
+        if (it->deadline > now) {
+            ++it;
+            continue;
+        }
+
+        // 超时未回复的 ID 放回队首重试，超过次数的放弃
+        for (int id : it->pending) {
+            m_batchOfId.remove(id);
+            if (++m_attempts[id] < kMaxAttempts && !m_queued.contains(id)) {
+                m_queue.push_front(id);
+                m_queued.insert(id);
+            } else {
+                qWarning() << "Giving up friend detail for" << id;
+            }
+        }
+        it = m_batches.erase(it);
+        released = true;
+    }
+
+    if (released) {
+        pump();
+    }
+}
+
+void FriendDetailLoader::loadCache()
+{
+    m_cache.clear();
+    m_cacheDirty = false;
+
+    QFile file(cachePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    const QByteArray data = file.readAll();
+    json root = json::parse(data.constData(), data.constData() + data.size(), nullptr, false);
+    if (root.is_discarded() || !root.is_object()) {
+        qWarning() << "Ignoring corrupt friend detail cache:" << file.fileName();
+        return;
+    }
+
+    m_cache.reserve(static_cast<int>(root.size()));
+    for (auto it = root.begin(); it != root.end(); ++it) {
+        const int id = QString::fromStdString(it.key()).toInt();
+        if (id == 0 || !it->is_object()) {
+            continue;
+        }
+
+        CachedDetail& entry = m_cache[id];
+        entry.info.id = id;
+        entry.info.name = detailString(*it, "name");
+        entry.info.part = detailString(*it, "part");
+        entry.info.email = detailString(*it, "email");
+        entry.info.img = detailString(*it, "img");
+        entry.info.sign = detailString(*it, "sign");
+        entry.etag = detailString(*it, "etag");
+    }
+}
+
+void FriendDetailLoader::saveCache()
+{
+    m_saveTimer.stop();
+    if (!m_cacheDirty || m_userId.isEmpty()) {
+        return;
+    }
+
+    json root = json::object();
+    for (auto it = m_cache.constBegin(); it != m_cache.constEnd(); ++it) {
+        const FRIENDINFO& info = it->info;
+        root[std::to_string(it.key())] = {
+            {"name", info.name.toStdString()},
+            {"part", info.part.toStdString()},
+            {"email", info.email.toStdString()},
+            {"img", info.img.toStdString()},
+            {"sign", info.sign.toStdString()},
+            {"etag", it->etag.toStdString()}
+        };
+    }
+
+    const QString path = cachePath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile out(path);
+    const std::string text = root.dump();
+    if (!out.open(QIODevice::WriteOnly)
+        || out.write(text.data(), static_cast<qint64>(text.size())) != static_cast<qint64>(text.size())
+        || !out.commit()) {
+        qWarning() << "Failed to save friend detail cache:" << path;
+        return;
+    }
+    m_cacheDirty = false;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+#include "third_party/nlohmann_json/include/nlohmann/json.hpp"
+#include "app/public.h"
+#include "network/MessageDispatcher.h"
+#include <deque>
+#include <vector>
+
+using json = nlohmann::json;
+
+class WebSocketClient;
+
+/**
+ * @brief 好友详情分批加载
+ * 登录后按批（默认 50 个）向服务器查询所有好友的详情（请求类型 "2"），同时最多有若干批（默认 4）在途。
+ * FriendsList 当前可见的好友排到队首优先加载。结果连同服务器给的 etag 缓存在
+ * AppDataLocation/frienddetails/<userId>.json：启动时先用缓存填充，请求时带上 etag，
+ * 服务器对未变化的好友回复 notModified 即可。每个请求对应一个回复：回复结束对应的批次（回显 requestId
+ * 时按它，否则按发送顺序），批内没有返回的 ID 视为没有详情，不做超时重试。主窗口在加载过程中始终可用
+ */
+class FriendDetailLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FriendDetailLoader(WebSocketClient* wsClient, QObject* parent = nullptr);
+    ~FriendDetailLoader() override;
+
+    void setBatchSize(int size) { m_batchSize = qMax(1, size); }
+    int batchSize() const { return m_batchSize; }
+
+    void setMaxInFlight(int count) { m_maxInFlight = qMax(1, count); }
+    int maxInFlight() const { return m_maxInFlight; }
+
+    /**
+     * @brief 开始加载
+     * @param userId 当前登录用户，决定缓存文件
+     * @param friendIds 全部好友 ID，按列表顺序
+     */
+    void start(const QString& userId, const QVector<int>& friendIds);
+
+    /// 把这些好友（通常是列表中可见的部分）移到队首
+    void prioritize(const QVector<int>& friendIds);
+
+    bool isFinished() const { return m_queue.empty() && m_batches.isEmpty(); }
+
+signals:
+    /// 一批详情就绪（来自缓存或服务器）；name 为空表示沿用列表中的名字
+    void detailsLoaded(const QVector<FRIENDINFO>& details);
+    void finished();
+
+private slots:
+    void pump();
+    void checkTimeouts();
+    void saveCache();
+
+private:
+    struct CachedDetail
+    {
+        FRIENDINFO info;
+        QString etag;
+    };
+
+    struct Batch
+    {
+        QSet<int> pending;
+        qint64 deadline = 0;
+    };
+
+    void handleResponse(const json& response);
+    void sendBatch();
+    void finishBatch(int batchId);
+    void loadCache();
+    QString cachePath() const;
+
+    WebSocketClient* m_client = nullptr;
+    std::vector<MessageSubscription> m_subscriptions;
+
+    std::deque<int> m_queue;            // 等待请求的好友 ID
+    QSet<int> m_queued;
+    QHash<int, Batch> m_batches;        // 在途批次
+    QHash<int, int> m_batchOfId;        // 好友 ID -> 在途批次
+    QHash<int, int> m_attempts;         // 超时重试次数
+    int m_nextBatchId = 1;
+
+    QHash<int, CachedDetail> m_cache;
+    QString m_userId;
+    bool m_cacheDirty = false;
+
+    int m_batchSize = 50;
+    int m_maxInFlight = 4;
+    QTimer m_timeoutTimer;
+    QTimer m_saveTimer;
+};
@@ -1,9 +1,11 @@
 #include "friendslist.h"
 
-#include <QHBoxLayout>
+#include "friendsmodel.h"
+
 #include <QLineEdit>
-#include <QListWidget>
-#include <QListWidgetItem>
+#include <QListView>
+#include <QScrollBar>
+#include <QTimer>
 #include <QVBoxLayout>
 
 FriendsList::FriendsList(QWidget* parent)
@@ -14,8 +16,14 @@ FriendsList::FriendsList(QWidget* parent)
     m_filterEdit = new QLineEdit(this);
     m_filterEdit->setPlaceholderText(QStringLiteral("搜索"));
 
-    m_list = new QListWidget(this);
+    m_model = new FriendsModel(this);
+    m_filter = new FriendsFilterModel(this);
+    m_filter->setSourceModel(m_model);
+
+    m_list = new QListView(this);
+    m_list->setModel(m_filter);
     m_list->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_list->setEditTriggers(QAbstractItemView::NoEditTriggers);
     m_list->setUniformItemSizes(true);
 
     auto* layout = new QVBoxLayout(this);
@@ -25,93 +33,87 @@ FriendsList::FriendsList(QWidget* parent)
     layout->addWidget(m_list);
     setLayout(layout);
 
-    connect(m_list, &QListWidget::itemActivated, this, &FriendsList::onItemActivated);
-    connect(m_list, &QListWidget::itemClicked, this, &FriendsList::onItemActivated);
+    connect(m_list, &QListView::activated, this, &FriendsList::onItemActivated);
+    connect(m_list, &QListView::clicked, this, &FriendsList::onItemActivated);
     connect(m_filterEdit, &QLineEdit::textChanged, this, &FriendsList::onFilterChanged);
+
+    m_visibleTimer = new QTimer(this);
+    m_visibleTimer->setSingleShot(true);
+    m_visibleTimer->setInterval(50);
+    connect(m_visibleTimer, &QTimer::timeout, this, &FriendsList::emitVisibleFriends);
+    connect(m_list->verticalScrollBar(), &QScrollBar::valueChanged, m_visibleTimer, qOverload<>(&QTimer::start));
+    connect(m_filter, &QAbstractItemModel::modelReset, m_visibleTimer, qOverload<>(&QTimer::start));
+    connect(m_filter, &QAbstractItemModel::layoutChanged, m_visibleTimer, qOverload<>(&QTimer::start));
 }
 
 void FriendsList::setFriends(const QVector<FRIENDINFO>& friends)
 {
-    m_allFriends = friends;
-    m_filteredFriends = friends;
-    rebuildList();
+    m_model->setFriends(friends);
 
-    if (m_list->count() > 0) {
-        m_list->setCurrentRow(0);
-        onItemActivated(m_list->item(0));
+    if (m_filter->rowCount() > 0) {
+        const QModelIndex first = m_filter->index(0, 0);
+        m_list->setCurrentIndex(first);
+        onItemActivated(first);
     }
 }
 
-FRIENDINFO FriendsList::currentFriend() const
+void FriendsList::updateFriends(const QVector<FRIENDINFO>& details)
 {
-    auto* item = m_list->currentItem();
-    if (!item) {
-        return {};
-    }
-
-    const int id = item->data(Qt::UserRole).toInt();
-    for (const auto& f : m_filteredFriends) {
-        if (f.id == id) {
-            return f;
-        }
-    }
-    for (const auto& f : m_allFriends) {
-        if (f.id == id) {
-            return f;
-        }
-    }
-    return {};
+    m_model->updateFriends(details);
 }
 
-void FriendsList::onItemActivated(QListWidgetItem* item)
+QVector<int> FriendsList::visibleFriendIds() const
 {
-    if (!item) {
-        return;
+    QVector<int> ids;
+    const QModelIndex top = m_list->indexAt(QPoint(0, 0));
+    if (!top.isValid()) {
+        return ids;
     }
 
-    const int id = item->data(Qt::UserRole).toInt();
-    for (const auto& f : m_filteredFriends) {
-        if (f.id == id) {
-            emit friendSelected(f);
-            return;
-        }
+    const QModelIndex bottom = m_list->indexAt(QPoint(0, m_list->viewport()->height() - 1));
+    const int last = bottom.isValid() ? bottom.row() : m_filter->rowCount() - 1;
+    ids.reserve(last - top.row() + 1);
+    for (int row = top.row(); row <= last; ++row) {
+        ids.append(m_filter->index(row, 0).data(FriendsModel::IdRole).toInt());
     }
+    return ids;
 }
 
-void FriendsList::onFilterChanged(const QString& text)
+void FriendsList::emitVisibleFriends()
 {
-    const QString keyword = text.trimmed().toLower();
+    emit visibleFriendsChanged(visibleFriendIds());
+}
 
-    if (keyword.isEmpty()) {
-        m_filteredFriends = m_allFriends;
-        rebuildList();
-        return;
+FRIENDINFO FriendsList::currentFriend() const
+{
+    const QModelIndex source = m_filter->mapToSource(m_list->currentIndex());
+    if (!source.isValid()) {
+        return {};
     }
+    return m_model->friendAt(source.row());
+}
 
-    m_filteredFriends.clear();
-    for (const auto& f : m_allFriends) {
-        if (f.name.toLower().contains(keyword) ||
-            f.part.toLower().contains(keyword) ||
-            f.email.toLower().contains(keyword) ||
-            QString::number(f.id).contains(keyword)) {
-            m_filteredFriends.push_back(f);
-        }
+bool FriendsList::findFriend(int id, FRIENDINFO& info) const
+{
+    const int row = m_model->rowOfId(id);
+    if (row < 0) {
+        return false;
     }
-
-    rebuildList();
+    info = m_model->friendAt(row);
+    return true;
 }
 
-void FriendsList::rebuildList()
+void FriendsList::onItemActivated(const QModelIndex& index)
 {
-    m_list->clear();
-
-    for (const auto& f : m_filteredFriends) {
-        auto* item = new QListWidgetItem(m_list);
-        item->setText(f.name.isEmpty() ? QString::number(f.id) : f.name);
-        item->setToolTip(QStringLiteral("%1\n%2\n%3")
-                             .arg(f.name)
-                             .arg(f.part)
-                             .arg(f.email));
-        item->setData(Qt::UserRole, f.id);
+    const QModelIndex source = m_filter->mapToSource(index);
+    if (!source.isValid()) {
+        return;
     }
+    emit friendSelected(m_model->friendAt(source.row()));
+}
+
+void FriendsList::onFilterChanged(const QString& text)
+{
+    // 代理模型以布局变化通知视图，当前选中的好友仍在结果中时保持选中
+    m_filter->setFilterText(text);
 }
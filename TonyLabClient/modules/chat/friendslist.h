@@ -4,9 +4,12 @@
 
 #include "app/public.h"
 
-class QListWidget;
-class QListWidgetItem;
+class FriendsFilterModel;
+class FriendsModel;
 class QLineEdit;
+class QListView;
+class QModelIndex;
+class QTimer;
 
 class FriendsList : public QWidget
 {
@@ -16,21 +19,30 @@ public:
     explicit FriendsList(QWidget* parent = nullptr);
 
     void setFriends(const QVector<FRIENDINFO>& friends);
+    void updateFriends(const QVector<FRIENDINFO>& details);
     FRIENDINFO currentFriend() const;
 
+    /// 按 ID 查找好友，不在列表中时返回 false
+    bool findFriend(int id, FRIENDINFO& info) const;
+
+    /// 当前显示在视口中的好友 ID
+    QVector<int> visibleFriendIds() const;
+
 signals:
     void friendSelected(const FRIENDINFO& friendInfo);
+    /// 滚动、过滤后视口中的好友变化（合并 50ms 内的变化）
+    void visibleFriendsChanged(const QVector<int>& friendIds);
 
 private slots:
-    void onItemActivated(QListWidgetItem* item);
+    void onItemActivated(const QModelIndex& index);
     void onFilterChanged(const QString& text);
+    void emitVisibleFriends();
 
 private:
-    void rebuildList();
-
-    QVector<FRIENDINFO> m_allFriends;
-    QVector<FRIENDINFO> m_filteredFriends;
+    FriendsModel* m_model = nullptr;
+    FriendsFilterModel* m_filter = nullptr;
 
     QLineEdit* m_filterEdit = nullptr;
-    QListWidget* m_list = nullptr;
+    QListView* m_list = nullptr;
+    QTimer* m_visibleTimer = nullptr;
 };
@@ -0,0 +1,255 @@
+#include "friendsmodel.h"
+
+#include <numeric>
+
+namespace
+{
+    constexpr int kRefilterDelayMs = 100;     // 详情更新后重新筛选的合并窗口
+
+    ContactSearchIndex::Document searchDocument(const FRIENDINFO& f)
+    {
+        ContactSearchIndex::Document document;
+        document.id = QString::number(f.id);
+        document.name = f.name;
+        document.part = f.part;
+        document.email = f.email;
+        return document;
+    }
+}
+
+FriendsModel::FriendsModel(QObject* parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int FriendsModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : m_friends.size();
+}
+
+QVariant FriendsModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_friends.size()) {
+        return QVariant();
+    }
+
+    const FRIENDINFO& f = m_friends.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return f.name.isEmpty() ? QString::number(f.id) : f.name;
+    case Qt::ToolTipRole:
+        return QStringLiteral("%1\n%2\n%3").arg(f.name, f.part, f.email);
+    case IdRole:
+        return f.id;
+    default:
+        return QVariant();
+    }
+}
+
+void FriendsModel::setFriends(const QVector<FRIENDINFO>& friends)
+{
+    beginResetModel();
+    m_friends = friends;
+
+    m_index.clear();
+    m_index.reserve(m_friends.size());
+    m_rowById.clear();
+    m_rowById.reserve(m_friends.size());
+
+    for (int row = 0; row < m_friends.size(); ++row) {
+        const FRIENDINFO& f = m_friends.at(row);
+        m_index.upsert(searchDocument(f));
+        m_rowById.insert(f.id, row);
+    }
+    endResetModel();
+}
+
+void FriendsModel::updateFriends(const QVector<FRIENDINFO>& details)
+{
+    for (const FRIENDINFO& detail : details) {
+        const int row = rowOfId(detail.id);
+        if (row < 0) {
+            continue;
+        }
+
+        FRIENDINFO& f = m_friends[row];
+        const QString name = detail.name.isEmpty() ? f.name : detail.name;
+        f = detail;
+        f.name = name;
+
+        m_index.upsert(searchDocument(f));
+
+        const QModelIndex changed = index(row);
+        emit dataChanged(changed, changed);
+    }
+}
+
+QVector<int> FriendsModel::search(const QString& query) const
+{
+    QVector<int> rows;
+    const auto matches = m_index.search(query);
+    rows.reserve(matches.size());
+    for (const auto& match : matches) {
+        const int row = rowOfId(match.id.toInt());
+        if (row >= 0) {
+            rows.append(row);
+        }
+    }
+    return rows;
+}
+
+FriendsFilterModel::FriendsFilterModel(QObject* parent)
+    : QAbstractProxyModel(parent)
+{
+    m_refilterTimer.setSingleShot(true);
+    m_refilterTimer.setInterval(kRefilterDelayMs);
+    connect(&m_refilterTimer, &QTimer::timeout, this, &FriendsFilterModel::refilter);
+}
+
+FriendsModel* FriendsFilterModel::friends() const
+{
+    return qobject_cast<FriendsModel*>(sourceModel());
+}
+
+void FriendsFilterModel::setSourceModel(QAbstractItemModel* sourceModel)
+{
+    if (this->sourceModel()) {
+        disconnect(this->sourceModel(), nullptr, this, nullptr);
+    }
+
+    QAbstractProxyModel::setSourceModel(sourceModel);
+    if (sourceModel) {
+        // 好友列表只会整体替换。详情更新先转发 dataChanged；有关键字时名字、部门等可能改变命中结果，
+        // 分批到达的详情合并后再重新筛选一次
+        connect(sourceModel, &QAbstractItemModel::modelReset, this, &FriendsFilterModel::resetRows);
+        connect(sourceModel, &QAbstractItemModel::dataChanged, this,
+            [this](const QModelIndex& topLeft, const QModelIndex& bottomRight, const QVector<int>& roles) {
+                for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+                    const QModelIndex proxy = mapFromSource(sourceModel()->index(row, 0));
+                    if (proxy.isValid()) {
+                        emit dataChanged(proxy, proxy, roles);
+                    }
+                }
+                if (!m_filter.isEmpty()) {
+                    m_refilterTimer.start();
+                }
+            });
+    }
+    resetRows();
+}
+
+void FriendsFilterModel::setFilterText(const QString& text)
+{
+    const QString filter = text.trimmed().toCaseFolded();
+    if (filter == m_filter) {
+        return;
+    }
+
+    // 错字容忍的匹配不随关键字变长单调收缩，每次都走倒排索引全量搜索，结果与输入过程无关
+    m_filter = filter;
+    refilter();
+}
+
+QVector<int> FriendsFilterModel::matchingRows() const
+{
+    QVector<int> rows;
+    FriendsModel* source = friends();
+    if (!source) {
+        return rows;
+    }
+    if (m_filter.isEmpty()) {
+        rows.resize(source->rowCount());
+        std::iota(rows.begin(), rows.end(), 0);
+        return rows;
+    }
+    return source->search(m_filter);
+}
+
+void FriendsFilterModel::setRows(QVector<int> rows)
+{
+    m_rows = std::move(rows);
+    m_proxyRowBySource.clear();
+    m_proxyRowBySource.reserve(m_rows.size());
+    for (int i = 0; i < m_rows.size(); ++i) {
+        m_proxyRowBySource.insert(m_rows.at(i), i);
+    }
+}
+
+void FriendsFilterModel::resetRows()
+{
+    // 源模型整体替换，原来的源行号已经没有意义
+    m_refilterTimer.stop();
+    beginResetModel();
+    setRows(matchingRows());
+    endResetModel();
+}
+
+void FriendsFilterModel::refilter()
+{
+    m_refilterTimer.stop();
+    QVector<int> rows = matchingRows();
+    if (rows == m_rows) {
+        return;
+    }
+
+    // 只是命中的行和顺序变化，用布局变化代替重置：仍在结果中的当前项和选中项跟着源行移动，不会丢失
+    emit layoutAboutToBeChanged();
+    const QModelIndexList persistent = persistentIndexList();
+    QVector<int> persistentSource;
+    persistentSource.reserve(persistent.size());
+    for (const QModelIndex& index : persistent) {
+        persistentSource.append(index.row() < m_rows.size() ? m_rows.at(index.row()) : -1);
+    }
+
+    setRows(std::move(rows));
+
+    QModelIndexList updated;
+    updated.reserve(persistent.size());
+    for (int sourceRow : persistentSource) {
+        const int row = m_proxyRowBySource.value(sourceRow, -1);
+        updated.append(row >= 0 ? createIndex(row, 0) : QModelIndex());
+    }
+    changePersistentIndexList(persistent, updated);
+    emit layoutChanged();
+}
+
+QModelIndex FriendsFilterModel::index(int row, int column, const QModelIndex& parent) const
+{
+    if (parent.isValid() || column != 0 || row < 0 || row >= m_rows.size()) {
+        return QModelIndex();
+    }
+    return createIndex(row, column);
+}
+
+QModelIndex FriendsFilterModel::parent(const QModelIndex& /*child*/) const
+{
+    return QModelIndex();
+}
+
+int FriendsFilterModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : m_rows.size();
+}
+
+int FriendsFilterModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : 1;
+}
+
+QModelIndex FriendsFilterModel::mapToSource(const QModelIndex& proxyIndex) const
+{
+    if (!proxyIndex.isValid() || !sourceModel() || proxyIndex.row() >= m_rows.size()) {
+        return QModelIndex();
+    }
+    return sourceModel()->index(m_rows.at(proxyIndex.row()), 0);
+}
+
+QModelIndex FriendsFilterModel::mapFromSource(const QModelIndex& sourceIndex) const
+{
+    if (!sourceIndex.isValid()) {
+        return QModelIndex();
+    }
+
+    const int row = m_proxyRowBySource.value(sourceIndex.row(), -1);
+    return row >= 0 ? createIndex(row, 0) : QModelIndex();
+}
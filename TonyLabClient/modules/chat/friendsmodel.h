@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QAbstractProxyModel>
+#include <QHash>
+#include <QTimer>
+#include <QVector>
+
+#include "app/public.h"
+#include "ContactSearchIndex.h"
+
+/**
+ * @brief 好友列表模型
+ * setFriends 时为名字/部门/邮箱/ID/拼音首字母建立一次搜索索引（ContactSearchIndex），
+ * 过滤时不再逐次 toLower 分配字符串；按 ID 查找走哈希表
+ */
+class FriendsModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles
+    {
+        IdRole = Qt::UserRole
+    };
+
+    explicit FriendsModel(QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    void setFriends(const QVector<FRIENDINFO>& friends);
+
+    /// 按 ID 更新已有好友的详情（name 为空时保留原名字），不在列表中的忽略
+    void updateFriends(const QVector<FRIENDINFO>& details);
+
+    const FRIENDINFO& friendAt(int row) const { return m_friends.at(row); }
+
+    /**
+     * @brief 搜索好友
+     * @return 命中的行，按匹配程度从高到低排列
+     */
+    QVector<int> search(const QString& query) const;
+
+    /// 好友所在行，不存在时返回 -1
+    int rowOfId(int id) const { return m_rowById.value(id, -1); }
+
+private:
+    QVector<FRIENDINFO> m_friends;
+    ContactSearchIndex m_index;     // 以 QString::number(id) 为键
+    QHash<int, int> m_rowById;
+};
+
+/**
+ * @brief 好友列表过滤代理
+ * 只保存命中行的源行号（按匹配程度排序，无关键字时为源顺序）。每次关键字变化都查倒排索引重新筛选，
+ * 结果只取决于关键字本身，与逐字输入还是粘贴无关。重新筛选以 layoutChanged 通知视图，
+ * 当前项和选中项在仍被命中时保留
+ */
+class FriendsFilterModel : public QAbstractProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit FriendsFilterModel(QObject* parent = nullptr);
+
+    void setSourceModel(QAbstractItemModel* sourceModel) override;
+
+    /// 设置过滤关键字（不区分大小写，匹配名字、部门、邮箱、ID 或拼音首字母，容忍少量错字）
+    void setFilterText(const QString& text);
+
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex& child) const override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex mapToSource(const QModelIndex& proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex& sourceIndex) const override;
+
+private:
+    QVector<int> matchingRows() const;
+    void setRows(QVector<int> rows);
+    void resetRows();       // 源模型重置时
+    void refilter();        // 关键字或详情变化时，以布局变化通知视图
+    FriendsModel* friends() const;
+
+    QString m_filter;           // 已折叠大小写
+    QVector<int> m_rows;        // 命中的源行号
+    QHash<int, int> m_proxyRowBySource;
+    QTimer m_refilterTimer;     // 有关键字时，详情陆续到达后合并重新筛选
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief 按 ID 索引的有序集合
+ * 元素按插入顺序保存在 QVector 中（稳定的行号，供列表视图使用），另有 ID -> 行号哈希表，
+ * 查找、更新都是 O(1)；删除需要把后面的行号前移，是 O(n) 但很少发生。
+ * T 需要有 QString 类型的 id 成员
+ */
+template <typename T>
+class IndexedStore
+{
+public:
+    int size() const { return m_items.size(); }
+    bool isEmpty() const { return m_items.isEmpty(); }
+
+    const QVector<T>& items() const { return m_items; }
+    const T& at(int row) const { return m_items.at(row); }
+
+    /// ID 所在行，不存在返回 -1
+    int rowOf(const QString& id) const { return m_rows.value(id, -1); }
+
+    bool contains(const QString& id) const { return m_rows.contains(id); }
+
+    T* find(const QString& id)
+    {
+        const int row = rowOf(id);
+        return row >= 0 ? &m_items[row] : nullptr;
+    }
+
+    /// 整体替换
+    void reset(const QVector<T>& items)
+    {
+        m_items = items;
+        m_rows.clear();
+        m_rows.reserve(m_items.size());
+        for (int row = 0; row < m_items.size(); ++row) {
+            m_rows.insert(m_items.at(row).id, row);
+        }
+    }
+
+    /**
+     * @brief 新增或替换
+     * @param inserted 返回是否为新增（追加在末尾）
+     * @return 元素所在行
+     */
+    int upsert(const T& item, bool* inserted = nullptr)
+    {
+        const int existing = rowOf(item.id);
+        if (inserted) {
+            *inserted = existing < 0;
+        }
+        if (existing >= 0) {
+            m_items[existing] = item;
+            return existing;
+        }
+
+        m_items.append(item);
+        m_rows.insert(item.id, m_items.size() - 1);
+        return m_items.size() - 1;
+    }
+
+    /**
+     * @brief 删除
+     * @return 被删除元素原来所在的行，不存在返回 -1
+     */
+    int remove(const QString& id)
+    {
+        const int row = rowOf(id);
+        if (row < 0) {
+            return -1;
+        }
+
+        m_items.removeAt(row);
+        m_rows.remove(id);
+        for (int i = row; i < m_items.size(); ++i) {
+            m_rows[m_items.at(i).id] = i;
+        }
+        return row;
+    }
+
+    void clear()
+    {
+        m_items.clear();
+        m_rows.clear();
+    }
+
+private:
+    QVector<T> m_items;
+    QHash<QString, int> m_rows;
+};
@@ -1,11 +1,95 @@
 #pragma once
 
+#include <QByteArray>
 #include <QString>
 #include <QDateTime>
+#include <QUuid>
 #include "third_party/nlohmann_json/include/nlohmann/json.hpp"
 
 using json = nlohmann::json;
 
+/**
+ * @brief 从 JSON 读取字符串字段
+ * 直接引用 json 内部的 std::string 构造 QString，避免中间临时串；
+ * 字段不存在或类型不符时返回空串
+ */
+inline QString jsonString(const json& j, const char* key)
+{
+    auto it = j.find(key);
+    if (it == j.end() || !it->is_string()) {
+        return QString();
+    }
+    const auto& value = it->get_ref<const std::string&>();
+    return QString::fromUtf8(value.data(), static_cast<int>(value.size()));
+}
+
+/**
+ * @brief 用户 ID 的紧凑表示：纯数字 ID 写成整数，其余原样写成字符串
+ */
+inline json compactUserId(const QString& userId)
+{
+    bool ok = false;
+    const qint64 value = userId.toLongLong(&ok);
+    if (ok && value >= 0 && QString::number(value) == userId) {
+        return value;
+    }
+    return userId.toStdString();
+}
+
+/// 读取 compactUserId 写出的字段（整数或字符串）
+inline QString jsonUserId(const json& j, const char* key)
+{
+    auto it = j.find(key);
+    if (it != j.end() && it->is_number_integer()) {
+        return QString::number(it->get<qint64>());
+    }
+    return jsonString(j, key);
+}
+
+/**
+ * @brief 写入紧凑格式的消息 ID，编码由键名标明，读取时不需要猜测
+ * UUID 在 binary 为 true 时以 "i" 写成 16 字节的 bin（CBOR / MessagePack，text JSON 无法表示），
+ * 否则以 "u" 写成 22 个字符的 base64url；不是 UUID 的 ID 以 "i" 原样写成字符串
+ */
+inline void writeCompactMessageId(json& j, const QString& id, bool binary)
+{
+    const QUuid uuid(id);
+    if (uuid.isNull()) {
+        j["i"] = id.toStdString();
+        return;
+    }
+
+    const QByteArray bytes = uuid.toRfc4122();
+    if (binary) {
+        j["i"] = json::binary(std::vector<std::uint8_t>(bytes.cbegin(), bytes.cend()));
+        return;
+    }
+    j["u"] = bytes.toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals).toStdString();
+}
+
+/// 读取 writeCompactMessageId 写出的消息 ID，UUID 统一为不带花括号的字符串；字段缺失或格式不符时返回空串
+inline QString readCompactMessageId(const json& j)
+{
+    QByteArray bytes;
+    auto it = j.find("u");
+    if (it != j.end() && it->is_string()) {
+        bytes = QByteArray::fromBase64(QByteArray::fromStdString(it->get_ref<const std::string&>()),
+                                       QByteArray::Base64UrlEncoding);
+    } else {
+        it = j.find("i");
+        if (it == j.end() || !it->is_binary()) {
+            return jsonString(j, "i");
+        }
+        const auto& value = it->get_binary();
+        bytes = QByteArray(reinterpret_cast<const char*>(value.data()), static_cast<int>(value.size()));
+    }
+
+    if (bytes.size() != 16) {
+        return QString();
+    }
+    return QUuid::fromRfc4122(bytes).toString(QUuid::WithoutBraces);
+}
+
 /**
  * @brief 消息数据模型
  */
@@ -39,17 +123,67 @@ struct Message
     static Message fromJson(const json& j)
     {
         Message msg;
-        if (j.contains("id")) msg.id = QString::fromStdString(j["id"]);
-        if (j.contains("senderId")) msg.senderId = QString::fromStdString(j["senderId"]);
-        if (j.contains("senderName")) msg.senderName = QString::fromStdString(j["senderName"]);
-        if (j.contains("senderAvatar")) msg.senderAvatar = QString::fromStdString(j["senderAvatar"]);
-        if (j.contains("receiverId")) msg.receiverId = QString::fromStdString(j["receiverId"]);
-        if (j.contains("content")) msg.content = QString::fromStdString(j["content"]);
-        if (j.contains("type")) msg.type = QString::fromStdString(j["type"]);
+        msg.id = jsonString(j, "id");
+        if (msg.id.isEmpty()) msg.id = jsonString(j, "messageId");     // 线上 im.message 使用 messageId
+        msg.senderId = jsonString(j, "senderId");
+        msg.senderName = jsonString(j, "senderName");
+        msg.senderAvatar = jsonString(j, "senderAvatar");
+        msg.receiverId = jsonString(j, "receiverId");
+        msg.content = jsonString(j, "content");
+        msg.type = jsonString(j, "contentType");
+        if (msg.type.isEmpty()) msg.type = jsonString(j, "type");
         if (j.contains("timestamp")) msg.timestamp = QDateTime::fromMSecsSinceEpoch(j["timestamp"]);
         if (j.contains("isSent")) msg.isSent = j["isSent"];
         return msg;
     }
+
+    /**
+     * @brief 紧凑线上格式（im.message 的精简 schema）
+     * {"i" 或 "u": 消息 ID, "s": 发送者, "r": 接收者, "c": 内容, "t": 毫秒时间戳}，
+     * 用户 ID 为整数，消息 ID 见 writeCompactMessageId；内容类型不是 text 时才带 "k"。
+     * 发送者名称 / 头像只在 withProfile 为 true 时以 "sn" / "sa" 带上（资料变化后的第一条），
+     * 其余消息由接收方从本地联系人解析。不含 type，由调用方补上
+     */
+    json toCompactJson(bool binaryId, bool withProfile = false) const
+    {
+        json j = {
+            {"s", compactUserId(senderId)},
+            {"r", compactUserId(receiverId)},
+            {"c", content.toStdString()},
+            {"t", timestamp.toMSecsSinceEpoch()}
+        };
+        writeCompactMessageId(j, id, binaryId);
+        if (!type.isEmpty() && type != QLatin1String("text")) {
+            j["k"] = type.toStdString();
+        }
+        if (withProfile) {
+            j["sn"] = senderName.toStdString();
+            j["sa"] = senderAvatar.toStdString();
+        }
+        return j;
+    }
+
+    static Message fromCompactJson(const json& j)
+    {
+        Message msg;
+        msg.id = readCompactMessageId(j);
+        msg.senderId = jsonUserId(j, "s");
+        msg.receiverId = jsonUserId(j, "r");
+        msg.content = jsonString(j, "c");
+        msg.type = jsonString(j, "k");
+        if (msg.type.isEmpty()) msg.type = QStringLiteral("text");
+        msg.senderName = jsonString(j, "sn");
+        msg.senderAvatar = jsonString(j, "sa");
+        auto it = j.find("t");
+        if (it != j.end() && it->is_number()) msg.timestamp = QDateTime::fromMSecsSinceEpoch(it->get<qint64>());
+        return msg;
+    }
+
+    /// 紧凑格式以消息 ID 字段 "i" / "u" 为标志
+    static bool isCompact(const json& j) { return j.contains("i") || j.contains("u"); }
+
+    /// 按字段自动选择完整或紧凑格式
+    static Message fromWire(const json& j) { return isCompact(j) ? fromCompactJson(j) : fromJson(j); }
 };
 
 /**
@@ -77,11 +211,11 @@ struct Contact
     static Contact fromJson(const json& j)
     {
         Contact contact;
-        if (j.contains("id")) contact.id = QString::fromStdString(j["id"]);
-        if (j.contains("name")) contact.name = QString::fromStdString(j["name"]);
-        if (j.contains("avatar")) contact.avatar = QString::fromStdString(j["avatar"]);
-        if (j.contains("status")) contact.status = QString::fromStdString(j["status"]);
-        if (j.contains("remark")) contact.remark = QString::fromStdString(j["remark"]);
+        contact.id = jsonString(j, "id");
+        contact.name = jsonString(j, "name");
+        contact.avatar = jsonString(j, "avatar");
+        contact.status = jsonString(j, "status");
+        contact.remark = jsonString(j, "remark");
         return contact;
     }
 };
@@ -116,13 +250,16 @@ struct Group
     static Group fromJson(const json& j)
     {
         Group group;
-        if (j.contains("id")) group.id = QString::fromStdString(j["id"]);
-        if (j.contains("name")) group.name = QString::fromStdString(j["name"]);
-        if (j.contains("avatar")) group.avatar = QString::fromStdString(j["avatar"]);
-        if (j.contains("description")) group.description = QString::fromStdString(j["description"]);
+        group.id = jsonString(j, "id");
+        group.name = jsonString(j, "name");
+        group.avatar = jsonString(j, "avatar");
+        group.description = jsonString(j, "description");
         if (j.contains("members") && j["members"].is_array()) {
             for (const auto& memberId : j["members"]) {
-                group.members.append(QString::fromStdString(memberId));
+                if (memberId.is_string()) {
+                    const auto& value = memberId.get_ref<const std::string&>();
+                    group.members.append(QString::fromUtf8(value.data(), static_cast<int>(value.size())));
+                }
             }
         }
         return group;
@@ -0,0 +1,477 @@
+#include "MessageStore.h"
+#include <QDebug>
+#include <QDir>
+#include <QStandardPaths>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    constexpr std::size_t kMaxOpenConversations = 32;     // 同时打开的会话文件上限
+    constexpr int kInitialScanLines = 64;                 // 打开会话时向前扫描的行数
+    constexpr int kScanChunkLines = 256;                  // 查找游标时每次向前扫描的行数
+
+    QString segmentFileName(const QString& conversationId, bool older)
+    {
+        // 会话 ID 可能含有文件名不允许的字符，统一转成十六进制
+        return QString::fromLatin1(conversationId.toUtf8().toHex())
+            + (older ? QStringLiteral(".old.log") : QStringLiteral(".log"));
+    }
+
+    template <typename Entry>
+    bool entryBefore(const Entry& a, const Entry& b)
+    {
+        return a.timestamp < b.timestamp;
+    }
+}
+
+MessageStore::~MessageStore()
+{
+    close();
+}
+
+bool MessageStore::open(const QString& userId)
+{
+    close();
+
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+        + QStringLiteral("/messages/") + userId;
+    if (!QDir().mkpath(dir)) {
+        qCritical() << "Cannot create message store:" << dir;
+        return false;
+    }
+
+    m_directory = dir;
+    qDebug() << "Message store opened:" << dir;
+    return true;
+}
+
+void MessageStore::close()
+{
+    for (auto& item : m_conversations) {
+        closeSegment(item.second->live);
+        closeSegment(item.second->older);
+    }
+    m_conversations.clear();
+    m_directory.clear();
+}
+
+MessageStore::Conversation* MessageStore::conversation(const QString& conversationId)
+{
+    if (m_directory.isEmpty() || conversationId.isEmpty()) {
+        return nullptr;
+    }
+
+    auto it = m_conversations.find(conversationId);
+    if (it != m_conversations.end()) {
+        it->second->lastAccess = ++m_accessClock;
+        return it->second.get();
+    }
+
+    evictIdle();
+
+    auto conv = std::make_unique<Conversation>();
+    conv->live.file.setFileName(m_directory + QLatin1Char('/') + segmentFileName(conversationId, false));
+    conv->older.file.setFileName(m_directory + QLatin1Char('/') + segmentFileName(conversationId, true));
+    if (!openSegment(conv->live, true)) {
+        return nullptr;
+    }
+    openSegment(conv->older, false);
+
+    // append 只把不早于它的消息写入 live 段，所以 live 段第一条就是其中最早的消息
+    conv->liveFloor = std::numeric_limits<qint64>::min();
+    if (conv->live.map) {
+        const char* base = reinterpret_cast<const char*>(conv->live.map);
+        const char* lineEnd = static_cast<const char*>(std::memchr(base, '\n', static_cast<std::size_t>(conv->live.mappedSize)));
+        const json first = json::parse(base, lineEnd ? lineEnd : base + conv->live.mappedSize, nullptr, false);
+        if (first.is_object()) {
+            auto tsIt = first.find("timestamp");
+            if (tsIt != first.end() && tsIt->is_number()) {
+                conv->liveFloor = tsIt->get<qint64>();
+            }
+        }
+    }
+
+    // older 段只读最后一行，取得它的 maxTs；打开会话通常不需要继续扫描它
+    scanBackward(*conv, conv->live, kInitialScanLines);
+    scanBackward(*conv, conv->older, 1);
+    conv->lastAccess = ++m_accessClock;
+
+    Conversation* result = conv.get();
+    m_conversations.emplace(conversationId, std::move(conv));
+    return result;
+}
+
+void MessageStore::evictIdle()
+{
+    if (m_conversations.size() < kMaxOpenConversations) {
+        return;
+    }
+
+    auto oldest = std::min_element(m_conversations.begin(), m_conversations.end(),
+        [](const auto& a, const auto& b) { return a.second->lastAccess < b.second->lastAccess; });
+
+    closeSegment(oldest->second->live);
+    closeSegment(oldest->second->older);
+    m_conversations.erase(oldest);
+}
+
+bool MessageStore::openSegment(Segment& segment, bool create)
+{
+    if (!create && !segment.file.exists()) {
+        return false;
+    }
+    if (!segment.file.open(QIODevice::ReadWrite)) {
+        qWarning() << "Cannot open message segment:" << segment.file.fileName() << segment.file.errorString();
+        return false;
+    }
+
+    // 崩溃时残留的半行：补一个换行把它隔开，之后的追加不会与之粘连
+    const qint64 size = segment.file.size();
+    if (size > 0) {
+        char last = 0;
+        if (segment.file.seek(size - 1) && segment.file.getChar(&last) && last != '\n') {
+            segment.file.write("\n", 1);
+            segment.file.flush();
+        }
+    }
+
+    segment.scannedFrom = segment.file.size();
+    segment.unscannedMax = std::numeric_limits<qint64>::max();
+    segment.maxTimestamp = std::numeric_limits<qint64>::min();
+    if (segment.scannedFrom > 0 && !mapFile(segment)) {
+        segment.scannedFrom = 0;    // 读不出来的内容只能当作不存在
+    }
+    return true;
+}
+
+void MessageStore::closeSegment(Segment& segment)
+{
+    if (segment.map) {
+        segment.file.unmap(segment.map);
+        segment.map = nullptr;
+    }
+    segment.file.close();
+}
+
+bool MessageStore::mapFile(Segment& segment)
+{
+    if (segment.map) {
+        segment.file.unmap(segment.map);
+        segment.map = nullptr;
+        segment.mappedSize = 0;
+    }
+
+    const qint64 size = segment.file.size();
+    if (size == 0) {
+        return false;
+    }
+
+    segment.map = segment.file.map(0, size);
+    if (!segment.map) {
+        qWarning() << "Cannot map message segment:" << segment.file.fileName();
+        return false;
+    }
+    segment.mappedSize = size;
+    return true;
+}
+
+bool MessageStore::hasUnscanned(const Conversation& conv)
+{
+    return conv.live.scannedFrom > 0 || conv.older.scannedFrom > 0;
+}
+
+qint64 MessageStore::unscannedMax(const Conversation& conv)
+{
+    qint64 bound = std::numeric_limits<qint64>::min();
+    if (conv.live.scannedFrom > 0) {
+        bound = conv.live.unscannedMax;
+    }
+    if (conv.older.scannedFrom > 0) {
+        bound = qMax(bound, conv.older.unscannedMax);
+    }
+    return bound;
+}
+
+int MessageStore::scanMore(Conversation& conv, int maxLines)
+{
+    // 先扫描可能含有更新消息的一段；live 段在前时 older 段通常一直不需要读
+    const bool live = conv.live.scannedFrom > 0
+        && (conv.older.scannedFrom == 0 || conv.live.unscannedMax >= conv.older.unscannedMax);
+    return scanBackward(conv, live ? conv.live : conv.older, maxLines);
+}
+
+int MessageStore::scanBackward(Conversation& conv, Segment& segment, int maxLines)
+{
+    // 已扫描区间之前的数据在映射建立前就已写入，映射一定覆盖 [0, scannedFrom)
+    if (segment.scannedFrom == 0 || !segment.map) {
+        return 0;
+    }
+
+    const bool older = &segment == &conv.older;
+    const char* base = reinterpret_cast<const char*>(segment.map);
+    std::vector<IndexEntry> found;
+    found.reserve(static_cast<std::size_t>(maxLines));
+
+    qint64 pos = segment.scannedFrom;
+    int lines = 0;
+    while (pos > 0 && lines < maxLines) {
+        const qint64 lineEnd = pos - 1;     // 指向上一行末尾的 '\n'
+        qint64 lineStart = lineEnd;
+        while (lineStart > 0 && base[lineStart - 1] != '\n') {
+            --lineStart;
+        }
+        pos = lineStart;
+        ++lines;
+
+        json j = json::parse(base + lineStart, base + lineEnd, nullptr, false);
+        if (j.is_discarded() || !j.is_object()) {
+            continue;
+        }
+
+        IndexEntry entry;
+        entry.offset = lineStart;
+        entry.length = static_cast<int>(lineEnd - lineStart);
+        entry.older = older;
+        entry.id = jsonString(j, "id");
+        auto tsIt = j.find("timestamp");
+        if (tsIt != j.end() && tsIt->is_number()) {
+            entry.timestamp = tsIt->get<qint64>();
+        }
+        // 没有 maxTs 的行给不出上界，只能假定更早的部分可能有任意时间戳
+        auto maxIt = j.find("maxTs");
+        const bool hasMax = maxIt != j.end() && maxIt->is_number();
+        const qint64 lineMax = hasMax ? qMax(maxIt->get<qint64>(), entry.timestamp) : entry.timestamp;
+        segment.unscannedMax = hasMax ? lineMax : std::numeric_limits<qint64>::max();
+        segment.maxTimestamp = qMax(segment.maxTimestamp, lineMax);
+
+        if (!entry.id.isEmpty() && !conv.ids.contains(entry.id)) {
+            conv.ids.insert(entry.id, entry.timestamp);
+            found.push_back(std::move(entry));
+        }
+    }
+    segment.scannedFrom = pos;
+    if (pos == 0) {
+        segment.unscannedMax = std::numeric_limits<qint64>::min();
+    }
+
+    if (found.empty()) {
+        return lines;
+    }
+
+    // found 是倒序读出的，翻转成写入顺序后稳定排序，再与已有索引归并
+    std::reverse(found.begin(), found.end());
+    std::stable_sort(found.begin(), found.end(), entryBefore<IndexEntry>);
+
+    const auto middle = static_cast<std::ptrdiff_t>(found.size());
+    conv.index.insert(conv.index.begin(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+    std::inplace_merge(conv.index.begin(), conv.index.begin() + middle, conv.index.end(), entryBefore<IndexEntry>);
+    return lines;
+}
+
+bool MessageStore::ensureScanned(Conversation& conv, const QString& messageId)
+{
+    while (!conv.ids.contains(messageId)) {
+        if (scanMore(conv, kScanChunkLines) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int MessageStore::positionOf(const Conversation& conv, const QString& messageId) const
+{
+    auto idIt = conv.ids.constFind(messageId);
+    if (idIt == conv.ids.constEnd()) {
+        return -1;
+    }
+
+    IndexEntry probe;
+    probe.timestamp = idIt.value();
+    auto it = std::lower_bound(conv.index.begin(), conv.index.end(), probe, entryBefore<IndexEntry>);
+    for (; it != conv.index.end() && it->timestamp == probe.timestamp; ++it) {
+        if (it->id == messageId) {
+            return static_cast<int>(it - conv.index.begin());
+        }
+    }
+    return -1;
+}
+
+void MessageStore::insertIndex(Conversation& conv, IndexEntry entry)
+{
+    // 绝大多数消息按时间顺序到达，直接追加；增量补齐的旧消息才需要二分插入
+    if (conv.index.empty() || conv.index.back().timestamp <= entry.timestamp) {
+        conv.index.push_back(std::move(entry));
+        return;
+    }
+
+    auto pos = std::upper_bound(conv.index.begin(), conv.index.end(), entry, entryBefore<IndexEntry>);
+    conv.index.insert(pos, std::move(entry));
+}
+
+const char* MessageStore::lineData(Conversation& conv, const IndexEntry& entry)
+{
+    // 映射之后又追加了数据，重新映射整个文件
+    Segment& segment = entry.older ? conv.older : conv.live;
+    if (entry.offset + entry.length > segment.mappedSize && !mapFile(segment)) {
+        return nullptr;
+    }
+    return reinterpret_cast<const char*>(segment.map) + entry.offset;
+}
+
+QList<Message> MessageStore::readRange(Conversation& conv, int first, int last)
+{
+    QList<Message> result;
+    result.reserve(qMax(0, last - first));
+
+    for (int i = first; i < last; ++i) {
+        const IndexEntry& entry = conv.index[static_cast<std::size_t>(i)];
+        const char* data = lineData(conv, entry);
+        if (!data) {
+            break;
+        }
+
+        json j = json::parse(data, data + entry.length, nullptr, false);
+        if (!j.is_discarded()) {
+            result.append(Message::fromJson(j));
+        }
+    }
+    return result;
+}
+
+bool MessageStore::append(const QString& conversationId, const Message& message)
+{
+    Conversation* conv = conversation(conversationId);
+    if (!conv || message.id.isEmpty()) {
+        return false;
+    }
+
+    // 比 live 段第一条还早的消息写入 older 段，live 段尾部始终是最新的消息
+    const qint64 timestamp = message.timestamp.toMSecsSinceEpoch();
+    const bool liveEmpty = conv->live.file.size() == 0;
+    const bool older = !liveEmpty && timestamp < conv->liveFloor;
+    Segment& segment = older ? conv->older : conv->live;
+
+    // 同一条消息只可能在它所属的段里；该段未扫描部分可能含有同一时间范围的消息，需要先纳入索引才能判断重复
+    while (segment.scannedFrom > 0 && timestamp <= segment.unscannedMax && !conv->ids.contains(message.id)) {
+        if (scanBackward(*conv, segment, kScanChunkLines) == 0) {
+            break;
+        }
+    }
+    if (conv->ids.contains(message.id)) {
+        return false;
+    }
+    if (older && !segment.file.isOpen() && !openSegment(segment, true)) {
+        return false;
+    }
+
+    segment.maxTimestamp = qMax(segment.maxTimestamp, timestamp);
+    json record = message.toJson();
+    record["maxTs"] = segment.maxTimestamp;
+    std::string line = record.dump();
+    line.push_back('\n');
+
+    const qint64 offset = segment.file.size();
+    if (!segment.file.seek(offset)
+        || segment.file.write(line.data(), static_cast<qint64>(line.size())) != static_cast<qint64>(line.size())) {
+        qWarning() << "Failed to append message:" << segment.file.fileName() << segment.file.errorString();
+        return false;
+    }
+    segment.file.flush();
+    if (liveEmpty && !older) {
+        conv->liveFloor = timestamp;
+    }
+
+    IndexEntry entry;
+    entry.offset = offset;
+    entry.length = static_cast<int>(line.size() - 1);
+    entry.timestamp = timestamp;
+    entry.older = older;
+    entry.id = message.id;
+
+    conv->ids.insert(message.id, timestamp);
+    insertIndex(*conv, std::move(entry));
+    return true;
+}
+
+QList<Message> MessageStore::latest(const QString& conversationId, int limit, bool* hasMore)
+{
+    return before(conversationId, QString(), limit, hasMore);
+}
+
+QList<Message> MessageStore::before(const QString& conversationId, const QString& beforeId, int limit, bool* hasMore)
+{
+    if (hasMore) {
+        *hasMore = false;
+    }
+
+    Conversation* conv = conversation(conversationId);
+    if (!conv || limit <= 0) {
+        return QList<Message>();
+    }
+
+    int end = static_cast<int>(conv->index.size());
+    if (!beforeId.isEmpty()) {
+        if (!ensureScanned(*conv, beforeId)) {
+            return QList<Message>();
+        }
+        end = positionOf(*conv, beforeId);
+    }
+
+    // 已扫描部分不够一页，或未扫描部分可能有时间落在这一页里的消息时继续向前扫描
+    while (hasUnscanned(*conv)
+           && (end < limit || conv->index[static_cast<std::size_t>(end - limit)].timestamp < unscannedMax(*conv))) {
+        if (scanMore(*conv, qMax(0, limit - end) + kInitialScanLines) == 0) {
+            break;
+        }
+        end = beforeId.isEmpty() ? static_cast<int>(conv->index.size()) : positionOf(*conv, beforeId);
+    }
+
+    const int first = qMax(0, end - limit);
+    if (hasMore) {
+        *hasMore = first > 0 || hasUnscanned(*conv);
+    }
+    return readRange(*conv, first, end);
+}
+
+QList<Message> MessageStore::after(const QString& conversationId, const QString& afterId, int limit)
+{
+    Conversation* conv = conversation(conversationId);
+    if (!conv || limit <= 0 || afterId.isEmpty() || !ensureScanned(*conv, afterId)) {
+        return QList<Message>();
+    }
+
+    const qint64 afterTimestamp = conv->ids.value(afterId);
+    while (hasUnscanned(*conv) && unscannedMax(*conv) > afterTimestamp) {
+        if (scanMore(*conv, kScanChunkLines) == 0) {
+            break;
+        }
+    }
+
+    const int first = positionOf(*conv, afterId) + 1;
+    const int last = qMin(static_cast<int>(conv->index.size()), first + limit);
+    return readRange(*conv, first, last);
+}
+
+QString MessageStore::lastMessageId(const QString& conversationId)
+{
+    Conversation* conv = conversation(conversationId);
+    if (!conv) {
+        return QString();
+    }
+
+    // 文件尾可能是补齐的旧消息，扫描到最新的一条不会再被未扫描部分超过为止
+    while (hasUnscanned(*conv) && (conv->index.empty() || conv->index.back().timestamp < unscannedMax(*conv))) {
+        if (scanMore(*conv, kScanChunkLines) == 0) {
+            break;
+        }
+    }
+    return conv->index.empty() ? QString() : conv->index.back().id;
+}
+
+bool MessageStore::contains(const QString& conversationId, const QString& messageId)
+{
+    Conversation* conv = conversation(conversationId);
+    return conv && ensureScanned(*conv, messageId);
+}
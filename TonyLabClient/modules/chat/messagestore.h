@@ -0,0 +1,123 @@
+#pragma once
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include "MessageModel.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief 本地消息库
+ * 每个会话两个追加写的段文件（每行一条 Message::toJson），用 QFile::map 映射后按需解析：
+ * live 段按到达顺序保存消息；比 live 段第一条更早的消息（向上翻页从服务器补齐的旧消息）写入 older 段，
+ * 因此 live 段第一条就是其中最早的消息，older 段中的消息都比它早。
+ * 索引是惰性的：打开会话时只从 live 段尾部向前扫描一小段，翻页需要更早的消息时再继续向前扫描，
+ * 所以上万条消息、翻过很多页的会话打开代价与一页相同。已扫描部分维护按时间戳排序的
+ * (timestamp, offset) 索引和消息 ID 表，用于游标翻页和去重。
+ *
+ * 段内文件顺序不一定等于时间顺序（增量补齐的消息可能略早于已有消息），所以每行额外记录
+ * "maxTs"：截至该行（含）段中最大的时间戳。已扫描区间最早一行的 maxTs 是该段未扫描部分时间戳的上界，
+ * 查询时总是先扫描上界更大的段，直到上界不会影响结果为止
+ */
+class MessageStore
+{
+public:
+    MessageStore() = default;
+    ~MessageStore();
+
+    MessageStore(const MessageStore&) = delete;
+    MessageStore& operator=(const MessageStore&) = delete;
+
+    /**
+     * @brief 打开用户的消息目录（AppDataLocation/messages/<userId>）
+     */
+    bool open(const QString& userId);
+
+    /// 关闭所有会话文件
+    void close();
+
+    bool isOpen() const { return !m_directory.isEmpty(); }
+
+    /**
+     * @brief 追加消息
+     * @return 新消息返回 true；ID 已存在时返回 false
+     */
+    bool append(const QString& conversationId, const Message& message);
+
+    /**
+     * @brief 最近的 limit 条消息（按时间升序）
+     */
+    QList<Message> latest(const QString& conversationId, int limit, bool* hasMore = nullptr);
+
+    /**
+     * @brief beforeId 之前的 limit 条消息（按时间升序）
+     * @param beforeId 游标，为空等同于 latest
+     * @param hasMore 返回本地是否还有更早的消息
+     */
+    QList<Message> before(const QString& conversationId, const QString& beforeId, int limit, bool* hasMore = nullptr);
+
+    /**
+     * @brief afterId 之后的 limit 条消息（按时间升序）
+     */
+    QList<Message> after(const QString& conversationId, const QString& afterId, int limit);
+
+    /**
+     * @brief 会话中时间最新的消息 ID，用于向服务器请求增量
+     */
+    QString lastMessageId(const QString& conversationId);
+
+    bool contains(const QString& conversationId, const QString& messageId);
+
+private:
+    struct IndexEntry
+    {
+        qint64 timestamp = 0;
+        qint64 offset = 0;
+        int length = 0;
+        bool older = false;     // 位于 older 段
+        QString id;
+    };
+
+    /// 一个段文件及其扫描进度
+    struct Segment
+    {
+        QFile file;
+        uchar* map = nullptr;
+        qint64 mappedSize = 0;
+        qint64 scannedFrom = 0;             // 已扫描区间的起始偏移，之前的行尚未建索引
+        qint64 unscannedMax = 0;            // [0, scannedFrom) 中时间戳的上界
+        qint64 maxTimestamp = 0;            // 段中最大的时间戳，写入新行的 maxTs
+    };
+
+    struct Conversation
+    {
+        Segment live;                       // 按到达顺序追加的消息
+        Segment older;                      // 比 liveFloor 更早的消息，没有时不创建文件
+        qint64 liveFloor = 0;               // live 段第一条的时间戳，live 段中没有更早的消息
+        std::vector<IndexEntry> index;      // 两段已扫描部分，按 timestamp 升序，同一时间戳按写入顺序
+        QHash<QString, qint64> ids;         // 已扫描的消息 ID -> timestamp
+        quint64 lastAccess = 0;
+    };
+
+    Conversation* conversation(const QString& conversationId);
+    bool openSegment(Segment& segment, bool create);
+    void closeSegment(Segment& segment);
+    bool mapFile(Segment& segment);
+    int scanBackward(Conversation& conv, Segment& segment, int maxLines);
+    int scanMore(Conversation& conv, int maxLines);
+    static bool hasUnscanned(const Conversation& conv);
+    static qint64 unscannedMax(const Conversation& conv);
+    bool ensureScanned(Conversation& conv, const QString& messageId);
+    int positionOf(const Conversation& conv, const QString& messageId) const;
+    void insertIndex(Conversation& conv, IndexEntry entry);
+    QList<Message> readRange(Conversation& conv, int first, int last);
+    const char* lineData(Conversation& conv, const IndexEntry& entry);
+    void evictIdle();
+
+    QString m_directory;
+    std::map<QString, std::unique_ptr<Conversation>> m_conversations;
+    quint64 m_accessClock = 0;
+};
@@ -2,17 +2,64 @@
 
 #include "ChatService.h"
 #include "chattoptoolbar.h"
+#include "chatwebbridge.h"
+#include "chatwebpage.h"
 #include "friendslist.h"
+#include "transcriptdelegate.h"
 #include "userdetaildlg.h"
 
 #include <QHBoxLayout>
+#include <QHideEvent>
 #include <QLineEdit>
+#include <QListView>
+#include <QScrollBar>
 #include <QPushButton>
+#include <QShowEvent>
 #include <QSplitter>
+#include <QTimer>
 #include <QVBoxLayout>
 
 #include <QtWebEngineWidgets/QWebEngineView>
-#include <QtWebEngineWidgets/QWebEnginePage>
+
+namespace
+{
+    // Native view asks for an older page once scrolled this close to the top.
+    constexpr int kOlderPageThreshold = 40;
+
+    MsgPane::TranscriptRenderer rendererFromEnvironment()
+    {
+        const QString value = qEnvironmentVariable("TONYLAB_CHAT_RENDERER").trimmed().toLower();
+        return value == QLatin1String("native") ? MsgPane::TranscriptRenderer::Native : MsgPane::TranscriptRenderer::Web;
+    }
+
+    MsgPane::TranscriptRenderer& defaultRendererRef()
+    {
+        static MsgPane::TranscriptRenderer renderer = rendererFromEnvironment();
+        return renderer;
+    }
+
+    json toJsItems(const QVector<TranscriptItem>& items)
+    {
+        json result = json::array();
+        for (const auto& item : items) {
+            result.push_back({
+                {"text", item.text.toStdString()},
+                {"out", item.outgoing}
+            });
+        }
+        return result;
+    }
+}
+
+void MsgPane::setDefaultRenderer(TranscriptRenderer renderer)
+{
+    defaultRendererRef() = renderer;
+}
+
+MsgPane::TranscriptRenderer MsgPane::defaultRenderer()
+{
+    return defaultRendererRef();
+}
 
 MsgPane::MsgPane(QWidget* parent)
     : QWidget(parent)
@@ -22,9 +69,16 @@ MsgPane::MsgPane(QWidget* parent)
     m_friends = new FriendsList(this);
     m_top = new ChatTopToolBar(this);
 
-    m_web = new QWebEngineView(this);
-    m_web->setContextMenuPolicy(Qt::NoContextMenu);
-    m_web->load(QUrl(QStringLiteral("qrc:/html/html/index1.html")));
+    if (defaultRenderer() == TranscriptRenderer::Native) {
+        createNativeTranscript();
+    } else {
+        createWebTranscript();
+    }
+
+    m_renderTimer = new QTimer(this);
+    m_renderTimer->setSingleShot(true);
+    m_renderTimer->setInterval(16);
+    connect(m_renderTimer, &QTimer::timeout, this, &MsgPane::flushRender);
 
     m_input = new QLineEdit(this);
     m_input->setPlaceholderText(QStringLiteral("输入消息..."));
@@ -42,7 +96,11 @@ MsgPane::MsgPane(QWidget* parent)
     right->setContentsMargins(0, 0, 0, 0);
     right->setSpacing(0);
     right->addWidget(m_top);
-    right->addWidget(m_web, 1);
+    if (m_web) {
+        right->addWidget(m_web, 1);
+    } else {
+        right->addWidget(m_list, 1);
+    }
 
     auto* inputWrap = new QWidget(this);
     inputWrap->setLayout(inputRow);
@@ -67,16 +125,72 @@ MsgPane::MsgPane(QWidget* parent)
     setLayout(root);
 
     connect(m_friends, &FriendsList::friendSelected, this, &MsgPane::onFriendSelected);
+    connect(m_friends, &FriendsList::visibleFriendsChanged, this, &MsgPane::visibleFriendsChanged);
     connect(m_send, &QPushButton::clicked, this, &MsgPane::onSendClicked);
     connect(m_input, &QLineEdit::returnPressed, this, &MsgPane::onSendClicked);
     connect(m_top, &ChatTopToolBar::contactDetailRequested, this, &MsgPane::onContactDetailRequested);
 }
 
+void MsgPane::createWebTranscript()
+{
+    m_web = new QWebEngineView(this);
+    m_web->setContextMenuPolicy(Qt::NoContextMenu);
+
+    // Usually already loaded in the background while the login dialog was up.
+    m_page = ChatWebPage::takePrewarmed(m_web);
+    m_web->setPage(m_page);
+
+    // The page asks for older pages through its bridge when scrolled to the top.
+    connect(m_page->bridge(), &ChatWebBridge::olderMessagesRequested, this, &MsgPane::onOlderMessagesRequested);
+}
+
+void MsgPane::createNativeTranscript()
+{
+    m_transcript = new TranscriptModel(this);
+
+    m_list = new QListView(this);
+    m_list->setProperty("form", "transcript");
+    m_list->setModel(m_transcript);
+    m_list->setItemDelegate(new TranscriptDelegate(m_list));
+    m_list->setSelectionMode(QAbstractItemView::NoSelection);
+    m_list->setFocusPolicy(Qt::NoFocus);
+    m_list->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    m_list->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    // Rows differ in height; relayout on resize so wrapping follows the width.
+    m_list->setUniformItemSizes(false);
+    m_list->setResizeMode(QListView::Adjust);
+    m_list->setLayoutMode(QListView::Batched);
+    m_list->setBatchSize(64);
+
+    connect(m_list->verticalScrollBar(), &QScrollBar::valueChanged, this, &MsgPane::onNativeScrolled);
+}
+
 void MsgPane::setFriendList(const QVector<FRIENDINFO>& friends)
 {
     m_friends->setFriends(friends);
 }
 
+bool MsgPane::findFriend(int id, FRIENDINFO& info) const
+{
+    return m_friends->findFriend(id, info);
+}
+
+void MsgPane::updateFriendDetails(const QVector<FRIENDINFO>& details)
+{
+    m_friends->updateFriends(details);
+
+    // Details may arrive after the contact was opened; refresh the header.
+    for (const auto& detail : details) {
+        if (detail.id == m_currentContact.id && detail.id != 0) {
+            const QString name = detail.name.isEmpty() ? m_currentContact.name : detail.name;
+            m_currentContact = detail;
+            m_currentContact.name = name;
+            m_top->setCurrentContact(m_currentContact);
+            break;
+        }
+    }
+}
+
 void MsgPane::setCurrentUser(int userId, const QString& userName, const QString& avatar)
 {
     m_currentUserId = userId;
@@ -97,17 +211,60 @@ void MsgPane::setChatService(ChatService* chatService)
 
     connect(m_chatService, &ChatService::messageReceived, this, &MsgPane::onServiceMessageReceived);
     connect(m_chatService, &ChatService::historyLoaded, this, &MsgPane::onServiceHistoryLoaded);
+    connect(m_chatService, &ChatService::olderHistoryLoaded, this, &MsgPane::onServiceOlderHistoryLoaded);
 
     if (m_currentUserId > 0) {
         m_chatService->setCurrentUser(QString::number(m_currentUserId), m_currentUserName, m_currentUserAvatar);
     }
+    updateActiveConversation();
+}
+
+void MsgPane::showEvent(QShowEvent* event)
+{
+    QWidget::showEvent(event);
+
+    // Minimizing does not hide child widgets, so watch the top-level window state too.
+    if (m_watchedWindow != window()) {
+        if (m_watchedWindow) {
+            m_watchedWindow->removeEventFilter(this);
+        }
+        m_watchedWindow = window();
+        m_watchedWindow->installEventFilter(this);
+    }
+    updateActiveConversation();
+}
+
+void MsgPane::hideEvent(QHideEvent* event)
+{
+    QWidget::hideEvent(event);
+    updateActiveConversation();
+}
+
+bool MsgPane::eventFilter(QObject* watched, QEvent* event)
+{
+    if (watched == m_watchedWindow && event->type() == QEvent::WindowStateChange) {
+        updateActiveConversation();
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+void MsgPane::updateActiveConversation()
+{
+    if (!m_chatService) {
+        return;
+    }
+
+    // Read receipts only go out for the conversation the user can actually see.
+    const bool visible = isVisible() && !window()->isMinimized() && m_currentContact.id != 0;
+    m_chatService->setActiveConversation(visible ? QString::number(m_currentContact.id) : QString());
 }
 
 void MsgPane::onFriendSelected(const FRIENDINFO& info)
 {
     m_currentContact = info;
     m_top->setCurrentContact(info);
-    clearWeb();
+    clearTranscript();
+    updateActiveConversation();
 
     if (m_chatService && info.id != 0) {
         m_chatService->fetchMessageHistory(QString::number(info.id));
@@ -125,7 +282,7 @@ void MsgPane::onSendClicked()
     }
 
     m_input->clear();
-    appendOutgoingToWeb(text);
+    appendOutgoing(text);
 
     emit sendTextRequested(QString::number(m_currentContact.id), text);
 
@@ -157,18 +314,19 @@ void MsgPane::onServiceMessageReceived(const Message& msg)
     }
 
     if (sender == contactId) {
-        appendIncomingToWeb(msg.content);
+        appendIncoming(msg.content);
     }
 }
 
-void MsgPane::onServiceHistoryLoaded(const QList<Message>& messages)
+void MsgPane::onServiceHistoryLoaded(const QString& conversationId, const QList<Message>& messages)
 {
-    if (m_currentContact.id == 0) {
+    // A late reply for a conversation we have already left must not land in the current transcript.
+    const QString contactId = QString::number(m_currentContact.id);
+    if (m_currentContact.id == 0 || conversationId != contactId) {
         return;
     }
 
-    // Current web view is already cleared when switching contacts.
-    const QString contactId = QString::number(m_currentContact.id);
+    // Current transcript is already cleared when switching contacts.
     const QString myId = QString::number(m_currentUserId);
 
     for (const auto& msg : messages) {
@@ -179,49 +337,165 @@ void MsgPane::onServiceHistoryLoaded(const QList<Message>& messages)
             continue;
         }
 
+        if (m_oldestMessageId.isEmpty()) {
+            m_oldestMessageId = msg.id;
+        }
+
         if (sender == contactId) {
-            appendIncomingToWeb(msg.content);
+            appendIncoming(msg.content);
         } else if (sender == myId) {
-            appendOutgoingToWeb(msg.content);
+            appendOutgoing(msg.content);
         }
     }
+
+    // A whole history page goes over in a single call.
+    flushRender();
 }
 
-QString MsgPane::toJsStringLiteral(const QString& s)
+void MsgPane::onOlderMessagesRequested()
 {
-    QString out = s;
-    out.replace('\\', "\\\\");
-    out.replace('\r', "\\r");
-    out.replace('\n', "\\n");
-    out.replace('\'', "\\'");
-    return QStringLiteral("'%1'").arg(out);
+    if (!m_chatService || m_currentContact.id == 0 || m_oldestMessageId.isEmpty()) {
+        // Nothing shown yet, so there is no cursor to page from; just release the loading flag.
+        prependOlder({}, true);
+        return;
+    }
+
+    m_chatService->fetchOlderMessages(QString::number(m_currentContact.id), m_oldestMessageId);
 }
 
-void MsgPane::appendOutgoingToWeb(const QString& text)
+void MsgPane::onServiceOlderHistoryLoaded(const QString& conversationId, const QList<Message>& messages, bool hasMore)
 {
-    if (!m_web || !m_web->page()) {
+    const QString contactId = QString::number(m_currentContact.id);
+    if (m_currentContact.id == 0 || conversationId != contactId) {
         return;
     }
 
-    const QString js = QStringLiteral("addMsg(%1);").arg(toJsStringLiteral(text));
-    m_web->page()->runJavaScript(js);
+    const QString myId = QString::number(m_currentUserId);
+    QVector<TranscriptItem> items;
+    items.reserve(messages.size());
+    for (const auto& msg : messages) {
+        if (msg.senderId != contactId && msg.senderId != myId) {
+            continue;
+        }
+        TranscriptItem item;
+        item.text = msg.content;
+        item.outgoing = msg.senderId == myId;
+        item.avatar = item.outgoing ? m_currentUserAvatar : m_currentContact.img;
+        items.append(item);
+    }
+
+    if (!messages.isEmpty()) {
+        m_oldestMessageId = messages.first().id;
+    }
+
+    prependOlder(items, hasMore);
 }
 
-void MsgPane::appendIncomingToWeb(const QString& text)
+void MsgPane::onNativeScrolled(int value)
 {
-    if (!m_web || !m_web->page()) {
+    if (value > kOlderPageThreshold || m_olderLoading || !m_hasMoreOlder || m_transcript->rowCount() == 0) {
         return;
     }
 
-    const QString js = QStringLiteral("addRecvMsg(%1);").arg(toJsStringLiteral(text));
-    m_web->page()->runJavaScript(js);
+    m_olderLoading = true;
+    onOlderMessagesRequested();
 }
 
-void MsgPane::clearWeb()
+void MsgPane::prependOlder(const QVector<TranscriptItem>& items, bool hasMore)
 {
-    if (!m_web || !m_web->page()) {
+    if (m_transcript) {
+        m_olderLoading = false;
+        m_hasMoreOlder = hasMore;
+        if (items.isEmpty()) {
+            return;
+        }
+
+        // Keep the row that was at the top of the viewport in place.
+        const QModelIndex top = m_list->indexAt(QPoint(0, 0));
+        m_transcript->prependItems(items);
+        if (top.isValid()) {
+            m_list->scrollTo(m_transcript->index(top.row() + items.size()), QAbstractItemView::PositionAtTop);
+        }
+        return;
+    }
+
+    if (!m_page) {
+        return;
+    }
+
+    // JSON is a valid JS literal, so the whole page goes over in one call.
+    const std::string payload = toJsItems(items).dump();
+    const QString js = QStringLiteral("prependMsgs(%1, %2);")
+        .arg(QString::fromUtf8(payload.data(), static_cast<int>(payload.size())),
+             hasMore ? QStringLiteral("true") : QStringLiteral("false"));
+    m_page->runWhenReady(js);
+}
+
+void MsgPane::appendOutgoing(const QString& text)
+{
+    queueRender(text, true);
+}
+
+void MsgPane::appendIncoming(const QString& text)
+{
+    queueRender(text, false);
+}
+
+void MsgPane::queueRender(const QString& text, bool outgoing)
+{
+    TranscriptItem item;
+    item.text = text;
+    item.outgoing = outgoing;
+    item.avatar = outgoing ? m_currentUserAvatar : m_currentContact.img;
+    m_renderQueue.append(item);
+
+    if (!m_renderTimer->isActive()) {
+        m_renderTimer->start();
+    }
+}
+
+void MsgPane::flushRender()
+{
+    m_renderTimer->stop();
+    if (m_renderQueue.isEmpty()) {
+        return;
+    }
+
+    const QVector<TranscriptItem> items = m_renderQueue;
+    m_renderQueue.clear();
+
+    if (m_transcript) {
+        m_transcript->appendItems(items);
+        m_list->scrollToBottom();
+        return;
+    }
+
+    if (!m_page) {
+        return;
+    }
+
+    // JSON is a valid JS literal; the page renders the whole batch in one frame.
+    const std::string payload = toJsItems(items).dump();
+    m_page->runWhenReady(QStringLiteral("addMsgs(%1);")
+        .arg(QString::fromUtf8(payload.data(), static_cast<int>(payload.size()))));
+}
+
+void MsgPane::clearTranscript()
+{
+    m_oldestMessageId.clear();
+    m_renderQueue.clear();
+    m_renderTimer->stop();
+
+    if (m_transcript) {
+        m_transcript->clear();
+        m_olderLoading = false;
+        m_hasMoreOlder = true;
+        return;
+    }
+
+    if (!m_page) {
         return;
     }
 
-    m_web->page()->runJavaScript(QStringLiteral("clear();"));
+    m_page->runWhenReady(QStringLiteral("clear();"));
 }
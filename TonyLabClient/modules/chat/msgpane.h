@@ -1,16 +1,21 @@
 #pragma once
 
 #include <QList>
+#include <QVector>
 #include <QWidget>
 
 #include "app/public.h"
 #include "MessageModel.h"
+#include "transcriptmodel.h"
 
 class ChatService;
+class ChatWebPage;
 class FriendsList;
 class ChatTopToolBar;
 class QLineEdit;
+class QListView;
 class QPushButton;
+class QTimer;
 class QWebEngineView;
 
 class MsgPane : public QWidget
@@ -18,15 +23,35 @@ class MsgPane : public QWidget
     Q_OBJECT
 
 public:
+    // How the chat transcript is drawn. Native skips QWebEngineView (and its Chromium process) entirely.
+    enum class TranscriptRenderer
+    {
+        Web,
+        Native
+    };
+
     explicit MsgPane(QWidget* parent = nullptr);
 
+    // Renderer used by panes created afterwards. Defaults to $TONYLAB_CHAT_RENDERER ("web" or "native"), else Web.
+    static void setDefaultRenderer(TranscriptRenderer renderer);
+    static TranscriptRenderer defaultRenderer();
+
     void setFriendList(const QVector<FRIENDINFO>& friends);
+    void updateFriendDetails(const QVector<FRIENDINFO>& details);
+    // Looks up a friend (including loaded details) by id; false if not in the list.
+    bool findFriend(int id, FRIENDINFO& info) const;
     void setCurrentUser(int userId, const QString& userName, const QString& avatar);
 
     void setChatService(ChatService* chatService);
 
 signals:
     void sendTextRequested(const QString& receiverId, const QString& content);
+    void visibleFriendsChanged(const QVector<int>& friendIds);
+
+protected:
+    void showEvent(QShowEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
+    bool eventFilter(QObject* watched, QEvent* event) override;
 
 private slots:
     void onFriendSelected(const FRIENDINFO& info);
@@ -34,13 +59,21 @@ private slots:
     void onContactDetailRequested(const FRIENDINFO& info);
 
     void onServiceMessageReceived(const Message& msg);
-    void onServiceHistoryLoaded(const QList<Message>& messages);
+    void onServiceHistoryLoaded(const QString& conversationId, const QList<Message>& messages);
+    void onServiceOlderHistoryLoaded(const QString& conversationId, const QList<Message>& messages, bool hasMore);
+    void onOlderMessagesRequested();
+    void onNativeScrolled(int value);
 
 private:
-    static QString toJsStringLiteral(const QString& s);
-    void appendOutgoingToWeb(const QString& text);
-    void appendIncomingToWeb(const QString& text);
-    void clearWeb();
+    void createWebTranscript();
+    void createNativeTranscript();
+    void appendOutgoing(const QString& text);
+    void appendIncoming(const QString& text);
+    void queueRender(const QString& text, bool outgoing);
+    void flushRender();
+    void prependOlder(const QVector<TranscriptItem>& items, bool hasMore);
+    void clearTranscript();
+    void updateActiveConversation();
 
     FRIENDINFO m_currentContact;
     int m_currentUserId = -1;
@@ -48,10 +81,21 @@ private:
     QString m_currentUserAvatar;
 
     ChatService* m_chatService = nullptr;
+    QString m_oldestMessageId;      // oldest message shown, cursor for scroll-up paging
+
+    // Messages waiting to be rendered; flushed to the transcript once per frame.
+    QVector<TranscriptItem> m_renderQueue;
+    QTimer* m_renderTimer = nullptr;
+    QWidget* m_watchedWindow = nullptr;
 
     FriendsList* m_friends = nullptr;
     ChatTopToolBar* m_top = nullptr;
-    QWebEngineView* m_web = nullptr;
+    QWebEngineView* m_web = nullptr;          // Web renderer only
+    ChatWebPage* m_page = nullptr;
+    QListView* m_list = nullptr;              // Native renderer only
+    TranscriptModel* m_transcript = nullptr;
+    bool m_olderLoading = false;              // Native renderer paging state; the page tracks its own
+    bool m_hasMoreOlder = true;
     QLineEdit* m_input = nullptr;
     QPushButton* m_send = nullptr;
 };
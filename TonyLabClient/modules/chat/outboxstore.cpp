@@ -0,0 +1,252 @@
+#include "OutboxStore.h"
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr int kSyncIntervalMs = 200;        // 缓冲写入最长停留时间
+    constexpr int kSyncThreshold = 64;          // 积累到该条数立即同步
+    constexpr int kCompactThreshold = 512;      // 已注销记录超过该数量且多于待发条目时压缩
+
+    bool fsyncFile(QFile& file)
+    {
+        if (!file.flush()) {
+            return false;
+        }
+#ifdef Q_OS_WIN
+        return _commit(file.handle()) == 0;
+#else
+        return ::fsync(file.handle()) == 0;
+#endif
+    }
+}
+
+OutboxStore::OutboxStore(QObject* parent)
+    : QObject(parent)
+{
+    m_syncTimer.setSingleShot(true);
+    m_syncTimer.setInterval(kSyncIntervalMs);
+    connect(&m_syncTimer, &QTimer::timeout, this, &OutboxStore::sync);
+}
+
+OutboxStore::~OutboxStore()
+{
+    close();
+}
+
+QString OutboxStore::defaultPath(const QString& userId)
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+        + QStringLiteral("/outbox");
+    return dir + QLatin1Char('/') + userId + QStringLiteral(".log");
+}
+
+bool OutboxStore::open(const QString& filePath)
+{
+    close();
+
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+    m_file.setFileName(filePath);
+
+    // 重放日志；崩溃时最后一行可能不完整，解析失败的行跳过，打开时重写日志把它清除
+    bool damaged = false;
+    if (m_file.open(QIODevice::ReadOnly)) {
+        int records = 0;
+        while (!m_file.atEnd()) {
+            const QByteArray line = m_file.readLine();
+            if (!line.endsWith('\n')) {
+                damaged = true;
+            }
+            json record = json::parse(line.constData(), line.constData() + line.size(), nullptr, false);
+            if (record.is_discarded() || !record.is_object()) {
+                damaged = true;
+                continue;
+            }
+            ++records;
+
+            auto opIt = record.find("op");
+            auto idIt = record.find("id");
+            if (opIt == record.end() || idIt == record.end() || !idIt->is_string()) {
+                continue;
+            }
+
+            const QString id = QString::fromStdString(idIt->get<std::string>());
+            if (*opIt == "add" && !m_seqById.contains(id)) {
+                const quint64 seq = m_nextSeq++;
+                m_entries.emplace(seq, std::make_pair(id, std::move(record["data"])));
+                m_seqById.insert(id, seq);
+            } else if (*opIt == "del") {
+                auto it = m_seqById.find(id);
+                if (it != m_seqById.end()) {
+                    m_entries.erase(it.value());
+                    m_seqById.erase(it);
+                }
+            }
+        }
+        m_file.close();
+        m_retiredRecords = records - m_seqById.size();
+    }
+
+    // 启动时顺带压缩，之后以追加模式写入。残缺的行也要清除，否则下一条记录会接在半行后面一起解析失败
+    if (m_retiredRecords > 0 || damaged) {
+        if (compact()) {
+            damaged = false;
+        } else {
+            qWarning() << "Failed to compact outbox:" << filePath;
+        }
+    }
+
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qCritical() << "Cannot open outbox:" << filePath << m_file.errorString();
+        return false;
+    }
+
+    // 压缩失败时至少补一个换行把半行隔开
+    if (damaged) {
+        m_file.write("\n", 1);
+        m_file.flush();
+    }
+
+    qDebug() << "Outbox opened:" << filePath << "pending:" << m_seqById.size();
+    return true;
+}
+
+void OutboxStore::close()
+{
+    if (m_file.isOpen()) {
+        sync();
+        m_file.close();
+    }
+    m_entries.clear();
+    m_seqById.clear();
+    m_nextSeq = 0;
+    m_retiredRecords = 0;
+}
+
+void OutboxStore::append(const QString& id, const json& data)
+{
+    if (id.isEmpty() || m_seqById.contains(id)) {
+        return;
+    }
+
+    const quint64 seq = m_nextSeq++;
+    m_entries.emplace(seq, std::make_pair(id, data));
+    m_seqById.insert(id, seq);
+
+    writeRecord({
+        {"op", "add"},
+        {"id", id.toStdString()},
+        {"data", data}
+    });
+}
+
+bool OutboxStore::retire(const QString& id)
+{
+    auto it = m_seqById.find(id);
+    if (it == m_seqById.end()) {
+        return false;
+    }
+
+    m_entries.erase(it.value());
+    m_seqById.erase(it);
+
+    writeRecord({
+        {"op", "del"},
+        {"id", id.toStdString()}
+    });
+
+    // add + del 两条记录都可以压缩掉
+    m_retiredRecords += 2;
+    if (m_retiredRecords > kCompactThreshold && m_retiredRecords > m_seqById.size()) {
+        sync();
+        m_file.close();
+        if (!compact()) {
+            qWarning() << "Failed to compact outbox:" << m_file.fileName();
+        }
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qCritical() << "Cannot reopen outbox:" << m_file.fileName() << m_file.errorString();
+        }
+    }
+    return true;
+}
+
+QList<json> OutboxStore::pending() const
+{
+    QList<json> result;
+    result.reserve(static_cast<int>(m_entries.size()));
+    for (const auto& entry : m_entries) {
+        result.append(entry.second.second);
+    }
+    return result;
+}
+
+void OutboxStore::writeRecord(const json& record)
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    std::string line = record.dump();
+    line.push_back('\n');
+    m_file.write(line.data(), static_cast<qint64>(line.size()));
+
+    ++m_unsyncedRecords;
+    scheduleSync();
+}
+
+void OutboxStore::scheduleSync()
+{
+    if (m_unsyncedRecords >= kSyncThreshold) {
+        sync();
+    } else if (!m_syncTimer.isActive()) {
+        m_syncTimer.start();
+    }
+}
+
+void OutboxStore::sync()
+{
+    m_syncTimer.stop();
+    if (!m_file.isOpen() || m_unsyncedRecords == 0) {
+        return;
+    }
+
+    if (!fsyncFile(m_file)) {
+        qWarning() << "Failed to sync outbox:" << m_file.fileName();
+    }
+    m_unsyncedRecords = 0;
+}
+
+bool OutboxStore::compact()
+{
+    QSaveFile out(m_file.fileName());
+    if (!out.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    for (const auto& entry : m_entries) {
+        json record = {
+            {"op", "add"},
+            {"id", entry.second.first.toStdString()},
+            {"data", entry.second.second}
+        };
+        std::string line = record.dump();
+        line.push_back('\n');
+        out.write(line.data(), static_cast<qint64>(line.size()));
+    }
+
+    if (!out.commit()) {
+        return false;
+    }
+
+    m_retiredRecords = 0;
+    return true;
+}
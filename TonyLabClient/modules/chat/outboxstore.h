@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include "third_party/nlohmann_json/include/nlohmann/json.hpp"
+#include <map>
+
+using json = nlohmann::json;
+
+/**
+ * @brief 离线发件箱
+ * 追加写日志：每行一条 JSON 记录，{"op":"add","id":...,"data":{...}} 登记待发条目，
+ * {"op":"del","id":...} 在收到服务器确认后注销。打开时重放日志恢复待发列表，
+ * 写入先进缓冲，定时（或积累到一定条数）统一 fsync，避免每条消息一次磁盘同步。
+ * 已注销记录过多时整体重写日志（QSaveFile 原子替换）
+ */
+class OutboxStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit OutboxStore(QObject* parent = nullptr);
+    ~OutboxStore() override;
+
+    /**
+     * @brief 打开（或创建）日志并恢复待发条目
+     * @param filePath 日志路径
+     */
+    bool open(const QString& filePath);
+
+    /// 同步并关闭日志
+    void close();
+
+    bool isOpen() const { return m_file.isOpen(); }
+
+    /**
+     * @brief 登记待发条目，同一 ID 重复登记会被忽略
+     */
+    void append(const QString& id, const json& data);
+
+    /**
+     * @brief 注销已确认的条目
+     * @return 条目存在并被注销时返回 true
+     */
+    bool retire(const QString& id);
+
+    bool contains(const QString& id) const { return m_seqById.contains(id); }
+
+    /// 按登记顺序返回所有待发条目
+    QList<json> pending() const;
+
+    int pendingCount() const { return m_seqById.size(); }
+
+    /// 立即把缓冲写入磁盘并 fsync
+    void sync();
+
+    /**
+     * @brief 默认日志路径：AppDataLocation/outbox/<userId>.log
+     */
+    static QString defaultPath(const QString& userId);
+
+private:
+    void writeRecord(const json& record);
+    void scheduleSync();
+    bool compact();
+
+    QFile m_file;
+    std::map<quint64, std::pair<QString, json>> m_entries;     // 序号 -> (ID, 数据)，保持登记顺序
+    QHash<QString, quint64> m_seqById;
+    quint64 m_nextSeq = 0;
+    int m_retiredRecords = 0;       // 日志中可被压缩掉的记录数
+    int m_unsyncedRecords = 0;
+    QTimer m_syncTimer;
+};
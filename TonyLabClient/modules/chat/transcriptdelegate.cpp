@@ -0,0 +1,154 @@
+#include "transcriptdelegate.h"
+#include "transcriptmodel.h"
+
+#include <QAbstractItemView>
+#include <QAbstractTextDocumentLayout>
+#include <QFile>
+#include <QPainter>
+#include <QPixmapCache>
+#include <QRegularExpression>
+#include <QTextDocument>
+#include <QtMath>
+
+namespace
+{
+    // 与 index1.html（litewebchat.css）的尺寸保持一致
+    constexpr int kAvatarSize = 34;
+    constexpr int kRowMargin = 7;           // 左右边距
+    constexpr int kRowGap = 4;              // 上下间距
+    constexpr int kAvatarSpacing = 10;      // 头像与气泡的间距
+    constexpr int kSideReserve = 64;        // 对侧留白
+    constexpr int kBubblePaddingH = 15;
+    constexpr int kBubblePaddingV = 10;
+    constexpr int kBubbleRadius = 10;
+    constexpr int kEmoticonSize = 24;
+    constexpr int kMaxCachedLayouts = 512;
+
+    const QString kDefaultAvatar = QStringLiteral(":/qss/res/Avatar.png");
+
+    // 正文转成富文本：转义 HTML，换行转 <br>，[emN] 转表情图片
+    QString toRichText(const QString& text)
+    {
+        static const QRegularExpression emoticon(QStringLiteral("\\[em(\\d{1,3})\\]"));
+
+        QString html;
+        html.reserve(text.size() + 16);
+
+        int last = 0;
+        auto it = emoticon.globalMatch(text);
+        while (it.hasNext()) {
+            const QRegularExpressionMatch match = it.next();
+            const QString path = QStringLiteral(":/emotion/emotion/%1.png").arg(match.captured(1));
+            if (!QFile::exists(path)) {
+                continue;
+            }
+            html += text.mid(last, match.capturedStart() - last).toHtmlEscaped();
+            html += QStringLiteral("<img src=\"%1\" width=\"%2\" height=\"%2\">").arg(path).arg(kEmoticonSize);
+            last = match.capturedEnd();
+        }
+        html += text.mid(last).toHtmlEscaped();
+        html.replace(QLatin1Char('\n'), QStringLiteral("<br>"));
+        return html;
+    }
+
+    QPixmap avatarPixmap(const QString& avatar)
+    {
+        const QString path = (!avatar.isEmpty() && QFile::exists(avatar)) ? avatar : kDefaultAvatar;
+        const QString key = QStringLiteral("transcript-avatar:") + path;
+
+        QPixmap pixmap;
+        if (!QPixmapCache::find(key, &pixmap)) {
+            pixmap = QPixmap(path).scaled(kAvatarSize, kAvatarSize, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+            QPixmapCache::insert(key, pixmap);
+        }
+        return pixmap;
+    }
+}
+
+TranscriptDelegate::TranscriptDelegate(QObject* parent)
+    : QStyledItemDelegate(parent)
+    , m_layouts(kMaxCachedLayouts)
+{
+}
+
+TranscriptDelegate::~TranscriptDelegate() = default;
+
+void TranscriptDelegate::clearLayoutCache()
+{
+    m_layouts.clear();
+}
+
+int TranscriptDelegate::maxBubbleTextWidth(const QStyleOptionViewItem& option) const
+{
+    // sizeHint 拿到的 option.rect 不一定是行宽，以视口宽度为准
+    const auto* view = qobject_cast<const QAbstractItemView*>(option.widget);
+    const int rowWidth = view ? view->viewport()->width() : option.rect.width();
+    const int reserved = 2 * kRowMargin + kAvatarSize + kAvatarSpacing + kSideReserve + 2 * kBubblePaddingH;
+    return qMax(kEmoticonSize, rowWidth - reserved);
+}
+
+QTextDocument* TranscriptDelegate::layoutFor(const QString& text, int maxWidth, const QFont& font) const
+{
+    const QString key = QString::number(maxWidth) + QLatin1Char('\n') + text;
+    if (QTextDocument* doc = m_layouts.object(key)) {
+        return doc;
+    }
+
+    auto* doc = new QTextDocument();
+    doc->setDefaultFont(font);
+    doc->setDocumentMargin(0);
+    doc->setHtml(toRichText(text));
+
+    // 短消息收缩到自然宽度，长消息在可用宽度内换行
+    doc->setTextWidth(-1);
+    doc->setTextWidth(qMin<qreal>(qCeil(doc->idealWidth()), maxWidth));
+
+    m_layouts.insert(key, doc);
+    return doc;
+}
+
+QSize TranscriptDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+    const QTextDocument* doc = layoutFor(index.data(TranscriptModel::TextRole).toString(),
+        maxBubbleTextWidth(option), option.font);
+
+    const int bubbleHeight = qCeil(doc->size().height()) + 2 * kBubblePaddingV;
+    return QSize(option.rect.width(), qMax(kAvatarSize, bubbleHeight) + 2 * kRowGap);
+}
+
+void TranscriptDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+    const bool outgoing = index.data(TranscriptModel::OutgoingRole).toBool();
+    QTextDocument* doc = layoutFor(index.data(TranscriptModel::TextRole).toString(),
+        maxBubbleTextWidth(option), option.font);
+
+    const QRect row = option.rect.adjusted(kRowMargin, kRowGap, -kRowMargin, -kRowGap);
+    const QRect avatarRect(outgoing ? row.right() - kAvatarSize + 1 : row.left(), row.top(), kAvatarSize, kAvatarSize);
+
+    QRect bubble(0, row.top(),
+        qCeil(doc->textWidth()) + 2 * kBubblePaddingH,
+        qCeil(doc->size().height()) + 2 * kBubblePaddingV);
+    if (outgoing) {
+        bubble.moveRight(avatarRect.left() - kAvatarSpacing);
+    } else {
+        bubble.moveLeft(avatarRect.right() + 1 + kAvatarSpacing);
+    }
+
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing);
+    painter->setRenderHint(QPainter::SmoothPixmapTransform);
+
+    painter->drawPixmap(avatarRect, avatarPixmap(index.data(TranscriptModel::AvatarRole).toString()));
+
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(outgoing ? QColor(0x3f, 0x8f, 0xe1) : QColor(255, 85, 127, 77));
+    painter->drawRoundedRect(bubble, kBubbleRadius, kBubbleRadius);
+
+    QAbstractTextDocumentLayout::PaintContext context;
+    context.palette = option.palette;
+    context.palette.setColor(QPalette::Text, outgoing ? QColor(Qt::white) : option.palette.color(QPalette::Text));
+    painter->translate(bubble.left() + kBubblePaddingH, bubble.top() + kBubblePaddingV);
+    doc->documentLayout()->draw(painter, context);
+
+    painter->restore();
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QCache>
+#include <QStyledItemDelegate>
+
+class QTextDocument;
+
+/**
+ * @brief 原生聊天气泡绘制
+ * 绘制头像、气泡和正文，正文中的 [emN] 替换为 resources/emotion 下的第 N 个表情。
+ * 每条消息按 (可用宽度, 正文) 缓存排版好的 QTextDocument，sizeHint 和 paint 共用，
+ * 滚动时不会重复排版；视图宽度变化后旧宽度的条目自然被淘汰
+ */
+class TranscriptDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    explicit TranscriptDelegate(QObject* parent = nullptr);
+    ~TranscriptDelegate() override;
+
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+    QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+
+    /// 字体或样式变化后丢弃缓存的排版
+    void clearLayoutCache();
+
+private:
+    int maxBubbleTextWidth(const QStyleOptionViewItem& option) const;
+    QTextDocument* layoutFor(const QString& text, int maxWidth, const QFont& font) const;
+
+    mutable QCache<QString, QTextDocument> m_layouts;
+};
@@ -0,0 +1,70 @@
+#include "transcriptmodel.h"
+
+TranscriptModel::TranscriptModel(QObject* parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int TranscriptModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : m_items.size();
+}
+
+QVariant TranscriptModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_items.size()) {
+        return QVariant();
+    }
+
+    const TranscriptItem& item = m_items.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+    case TextRole:
+        return item.text;
+    case OutgoingRole:
+        return item.outgoing;
+    case AvatarRole:
+        return item.avatar;
+    default:
+        return QVariant();
+    }
+}
+
+void TranscriptModel::appendItems(const QVector<TranscriptItem>& items)
+{
+    if (items.isEmpty()) {
+        return;
+    }
+
+    const int first = m_items.size();
+    beginInsertRows(QModelIndex(), first, first + items.size() - 1);
+    m_items.reserve(first + items.size());
+    for (const auto& item : items) {
+        m_items.append(item);
+    }
+    endInsertRows();
+}
+
+void TranscriptModel::prependItems(const QVector<TranscriptItem>& items)
+{
+    if (items.isEmpty()) {
+        return;
+    }
+
+    beginInsertRows(QModelIndex(), 0, items.size() - 1);
+    for (int i = items.size() - 1; i >= 0; --i) {
+        m_items.prepend(items.at(i));
+    }
+    endInsertRows();
+}
+
+void TranscriptModel::clear()
+{
+    if (m_items.isEmpty()) {
+        return;
+    }
+
+    beginResetModel();
+    m_items.clear();
+    endResetModel();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief 聊天记录中的一条消息（仅渲染需要的字段）
+ */
+struct TranscriptItem
+{
+    QString text;
+    bool outgoing = false;
+    QString avatar;         // 头像路径，为空时使用默认头像
+};
+
+/**
+ * @brief 原生聊天记录模型
+ * 配合 TranscriptDelegate 在 QListView 中绘制聊天气泡，替代 QWebEngineView + index1.html。
+ * 新消息追加在末尾，向上翻页的历史插入在开头，按时间升序排列
+ */
+class TranscriptModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles
+    {
+        TextRole = Qt::UserRole + 1,
+        OutgoingRole,
+        AvatarRole
+    };
+
+    explicit TranscriptModel(QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    /// 追加一批新消息
+    void appendItems(const QVector<TranscriptItem>& items);
+
+    /// 在开头插入一批更早的消息（按时间升序）
+    void prependItems(const QVector<TranscriptItem>& items);
+
+    void clear();
+
+private:
+    QList<TranscriptItem> m_items;      // QList 头部插入是均摊常数时间
+};
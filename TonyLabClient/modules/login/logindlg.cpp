@@ -11,7 +11,10 @@
 #include "wecomwnd.h"
 #include "utils/iconhelper.h"
 #include "pushbuttonex.h"
+#include "msgpane.h"
+#include "chatwebpage.h"
 #include "network/WebSocketClient.h"
+#include "network/MessageDispatcher.h"
 
 int gCurrentLoginId;
 QString gCurrentLoginName;
@@ -25,19 +28,33 @@ CLoginDlg::CLoginDlg(QWidget* parent)
 	initSlots();
 	relayout();
 
-	m_wsClient = new WebSocketClient(this);
+	//套接字与消息解码放到网络线程，GUI 线程只做分发
+	m_wsClient = new WebSocketClient(this, WebSocketClient::ThreadMode::Worker);
 	connect(m_wsClient, &WebSocketClient::dataReceived, this, &CLoginDlg::onReadyRead);
-	connect(m_wsClient, &WebSocketClient::messageReceived, this, [this](const json& message) {
-		handleServerMessage(message);
-	});
+	//登录阶段的回复经分发器路由，移交主窗口时注销
+	m_subscriptions.push_back(m_wsClient->dispatcher()->subscribe("0", [this](const json& response) {
+		handleLoginResponse(response);
+	}));
 
 	//连接服务器
 	m_wsClient->setAutoReconnect(true);
+	//优先协商 MessagePack 二进制帧，服务器不支持时自动回退 text JSON
+	m_wsClient->setPreferredWireFormat(WireFormat::MessagePack);
+	//同一轮事件循环内的多条小消息合并成一帧
+	m_wsClient->setBatchingEnabled(true);
+	//服务器支持时压缩较大的消息帧（历史记录、好友列表等）
+	m_wsClient->setCompressionEnabled(true);
 	m_wsClient->connectToServer(QStringLiteral("ws://127.0.0.1:6666"));
 	//QTimer::singleShot(2000, this, &CLoginDlg::onLogging);
 	//应该是按钮点击然后开始登录 
 	//向服务器发送一个查询的json指令
 	connect(m_loginBtn, &QPushButton::clicked, this, &CLoginDlg::onSendLoginRequest);
+
+	//登录框显示后在后台预热 WebEngine（profile、渲染进程、聊天页面），主窗口创建时直接接管
+	if (MsgPane::defaultRenderer() == MsgPane::TranscriptRenderer::Web)
+	{
+		QTimer::singleShot(0, this, []() { ChatWebPage::prewarm(); });
+	}
 }
 
 void CLoginDlg::createAllChildWnd()
@@ -204,21 +221,24 @@ void CLoginDlg::onLogging()
 	m_labUserName->setText(m_userName);
     m_labUserName->show();
 
-	//登录中查好友详情
-	if (!m_vFriendsId.isEmpty())
+	//先用登录回复里的好友名单构建主窗口，详情由 FriendDetailLoader 在后台分批加载（可见的优先），
+	//登录耗时与好友数量无关
+	QVector<FRIENDINFO> vFriendInfo;
+	vFriendInfo.reserve(m_vFriendsId.size());
+	for (int nId : m_vFriendsId)
 	{
-		//根据需求查登入后界面可视部分
-		QVector<int> vRequestId;
-		//假定只显示5个
-		for (int i = 0; i < qMin(5, m_vFriendsId.size()); ++i)
-		{
-			vRequestId.append(m_vFriendsId[i]);
-			qDebug() << "vRequestId = " << m_vFriendsId[i] << " ";
-		}
-		//发送查详情请求
-		sendFriendsDetailRequest(vRequestId);
+		vFriendInfo.append(m_mapFriends.value(nId));
 	}
-	//在显示主窗口之前，先设置号好友信息
+
+	m_weComWnd = new WeComWnd(m_wsClient);
+	handOverClient();
+	//设置个人信息
+	m_weComWnd->setUserDetail(m_userId, m_userName, m_userImg, m_userEmail, m_userPart);
+	//设置好友列表
+	m_weComWnd->setFriendList(vFriendInfo);
+	m_weComWnd->loadFriendDetails(m_vFriendsId);
+	//设置好后 再登录完成 显示页面
+	QTimer::singleShot(1000, this, &CLoginDlg::onLoginFinish);
 
 
 	//QTimer::singleShot(3000, this, &CLoginDlg::onLoginFinish);
@@ -235,10 +255,7 @@ void CLoginDlg::onSendLoginRequest()
 
 	//先测试wecomwnd显示
 	m_weComWnd = new WeComWnd(m_wsClient);
-	if (m_wsClient) {
-		m_wsClient->setParent(m_weComWnd);
-		disconnect(m_wsClient, nullptr, this, nullptr);
-	}
+	handOverClient();
 	m_weComWnd->show();
 	hide();
 	return ;
@@ -274,6 +291,18 @@ void CLoginDlg::onReadyRead(const QByteArray& data)
 	}
 }
 
+//连接交给主窗口，登录界面不再接收消息
+void CLoginDlg::handOverClient()
+{
+	if (!m_wsClient) {
+		return;
+	}
+
+	m_wsClient->setParent(m_weComWnd);
+	disconnect(m_wsClient, nullptr, this, nullptr);
+	m_subscriptions.clear();
+}
+
 void CLoginDlg::handleServerMessage(const json& response)
 {
 	const QString type = QString::fromStdString(response.value("type", std::string{}));
@@ -286,10 +315,6 @@ void CLoginDlg::handleServerMessage(const json& response)
 		handleLoginResponse(response);
 		return;
 	}
-	if (type == QStringLiteral("2")) {
-		handleFriendsDetailResponse(response);
-		return;
-	}
 
 	qDebug() << "Unsupported response type:" << type;
 }
@@ -325,60 +350,6 @@ void CLoginDlg::handleLoginResponse(const json& response)
 	QTimer::singleShot(2000, this, &CLoginDlg::onLogging);
 }
 
-//处理详情回复
-void CLoginDlg::handleFriendsDetailResponse(const json& response)
-{
-	const json dataObj = response.value("data", json::object());
-	//解析好友详情
-	QVector<FRIENDINFO> vFriendInfo;
-	vFriendInfo.clear();
-	if (dataObj.contains("friendDetails") && dataObj["friendDetails"].is_array()) {
-		for (const auto& detail : dataObj["friendDetails"]) {
-			const int nId = detail.value("id", 0);
-			if (!m_mapFriends.contains(nId)) {
-				continue;
-			}
-
-			auto& friendInfo = m_mapFriends[nId];
-			friendInfo.id = nId;
-			friendInfo.part = QString::fromStdString(detail.value("part", std::string{}));
-			friendInfo.email = QString::fromStdString(detail.value("email", std::string{}));
-			friendInfo.img = QString::fromStdString(detail.value("img", std::string{}));
-			friendInfo.sign = QString::fromStdString(detail.value("sign", std::string{}));
-			qDebug() << "friend details" << nId << friendInfo.name;
-			vFriendInfo.append(friendInfo);
-		}
-	}
-	//拿到好友详情后 拿信息构建主窗口
-	m_weComWnd = new WeComWnd(m_wsClient);
-	if (m_wsClient) {
-		m_wsClient->setParent(m_weComWnd);
-		disconnect(m_wsClient, nullptr, this, nullptr);
-	}
-	//设置个人信息
-	m_weComWnd->setUserDetail(m_userId, m_userName, m_userImg, m_userEmail, m_userPart);
-	//设置好友列表
-	m_weComWnd->setFriendList(vFriendInfo);
-	//设置好后 再登录完成 显示页面
-	QTimer::singleShot(1000, this, &CLoginDlg::onLoginFinish);
-	
-}
-
-void CLoginDlg::sendFriendsDetailRequest(const QVector<int>& vFriendIds)
-{
-	if (!m_wsClient) {
-		return;
-	}
-
-	json request;
-	request["type"] = "2";
-	request["friendIds"] = json::array();
-	for (int nId : vFriendIds) {
-		request["friendIds"].push_back(nId);
-	}
-
-	m_wsClient->sendMessage(request);
-}
 
 
 
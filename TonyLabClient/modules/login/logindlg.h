@@ -8,6 +8,7 @@
 #include "basedlg.h"
 
 #include "app/public.h"
+#include "network/MessageDispatcher.h"
 
 class QLineEdit;
 class CPushButtonEx;
@@ -28,8 +29,7 @@ private:
 	void relayout();
 	void handleServerMessage(const json& response);
 	void handleLoginResponse(const json& response);
-	void handleFriendsDetailResponse(const json& response);
-	void sendFriendsDetailRequest(const QVector<int>& vFriendIds);
+	void handOverClient();
 
 signals:
     //void SignalLoginFinish();
@@ -70,6 +70,8 @@ private:
 
 	//QTcpSocket* m_socket; //通信的端口
 	WebSocketClient* m_wsClient = nullptr;
+	//登录阶段的消息订阅，移交连接时释放
+	std::vector<MessageSubscription> m_subscriptions;
 	//主窗口
 	WeComWnd* m_weComWnd = nullptr;
 };
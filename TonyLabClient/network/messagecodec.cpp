@@ -0,0 +1,262 @@
+#include "messagecodec.h"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QUuid>
+#include <QtEndian>
+#include <array>
+#include <cstring>
+
+#if __has_include(<QtZlib/zlib.h>)
+#include <QtZlib/zlib.h>    // Qt 自带的 zlib，与 qCompress 同一份
+#else
+#include <zlib.h>
+#endif
+
+namespace
+{
+    // 让 nlohmann 的 binary_writer 直接写入 QByteArray
+    class ByteArrayOutputAdapter : public nlohmann::detail::output_adapter_protocol<char>
+    {
+    public:
+        explicit ByteArrayOutputAdapter(QByteArray& buffer) : m_buffer(buffer) {}
+
+        void write_character(char c) override
+        {
+            m_buffer.append(c);
+        }
+
+        void write_characters(const char* s, std::size_t length) override
+        {
+            m_buffer.append(s, static_cast<int>(length));
+        }
+
+    private:
+        QByteArray& m_buffer;
+    };
+
+    using BinaryWriter = nlohmann::detail::binary_writer<json, char>;
+
+    constexpr std::array<quint32, 256> makeCrcTable()
+    {
+        std::array<quint32, 256> table{};
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        return table;
+    }
+
+    constexpr std::array<quint32, 256> kCrcTable = makeCrcTable();
+}
+
+QString MessageCodec::formatName(WireFormat format)
+{
+    switch (format) {
+    case WireFormat::Cbor:
+        return QStringLiteral("cbor");
+    case WireFormat::MessagePack:
+        return QStringLiteral("msgpack");
+    case WireFormat::Json:
+    default:
+        return QStringLiteral("json");
+    }
+}
+
+bool MessageCodec::formatFromName(const std::string& name, WireFormat& format)
+{
+    if (name == "json") {
+        format = WireFormat::Json;
+    } else if (name == "cbor") {
+        format = WireFormat::Cbor;
+    } else if (name == "msgpack") {
+        format = WireFormat::MessagePack;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+QByteArray MessageCodec::encode(const json& message, WireFormat format)
+{
+    QByteArray frame;
+    frame.reserve(256);
+
+    auto adapter = std::make_shared<ByteArrayOutputAdapter>(frame);
+    BinaryWriter writer(adapter);
+
+    if (format == WireFormat::Cbor) {
+        frame.append(static_cast<char>(FrameTag::Cbor));
+        writer.write_cbor(message);
+    } else if (format == WireFormat::MessagePack) {
+        frame.append(static_cast<char>(FrameTag::MessagePack));
+        writer.write_msgpack(message);
+    } else {
+        const std::string text = message.dump();
+        frame.append(static_cast<char>(FrameTag::Json));
+        frame.append(text.data(), static_cast<int>(text.size()));
+    }
+
+    return frame;
+}
+
+QByteArray MessageCodec::compressFrame(const QByteArray& frame)
+{
+    // 超过对端解压上限的帧原样发送
+    if (frame.size() < 2 || frame.size() - 1 > kMaxDecompressedSize) {
+        return QByteArray();
+    }
+
+    // qCompress 输出为 4 字节大端原始长度 + zlib 流
+    const QByteArray body = qCompress(reinterpret_cast<const uchar*>(frame.constData()) + 1, frame.size() - 1);
+    if (body.size() + 1 >= frame.size()) {
+        return QByteArray();
+    }
+
+    QByteArray out;
+    out.reserve(body.size() + 1);
+    out.append(static_cast<char>(static_cast<quint8>(frame.at(0)) | kCompressedFlag));
+    out.append(body);
+    return out;
+}
+
+bool MessageCodec::decompressFrame(const QByteArray& frame, QByteArray& out, int maxSize)
+{
+    if (frame.size() < 5 || !(static_cast<quint8>(frame.at(0)) & kCompressedFlag)) {
+        return false;
+    }
+
+    // 声明长度由对端给出，不能交给 qUncompress：输出放不下时它会不断翻倍缓冲区，与声明长度无关。
+    // 这里只分配声明的长度，zlib 流超出或不足都视为非法帧
+    const uchar* compressed = reinterpret_cast<const uchar*>(frame.constData()) + 1;
+    const quint32 declared = qFromBigEndian<quint32>(compressed);
+    if (declared == 0 || declared > static_cast<quint32>(maxSize)) {
+        qWarning() << "Rejecting compressed frame, declared size" << declared;
+        return false;
+    }
+
+    out.resize(static_cast<int>(declared) + 1);
+    out[0] = static_cast<char>(static_cast<quint8>(frame.at(0)) & ~kCompressedFlag);
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) {
+        out.clear();
+        return false;
+    }
+    stream.next_in = const_cast<Bytef*>(compressed + 4);
+    stream.avail_in = static_cast<uInt>(frame.size() - 5);
+    stream.next_out = reinterpret_cast<Bytef*>(out.data() + 1);
+    stream.avail_out = declared;
+
+    // 输出缓冲区用完而流未结束时返回 Z_BUF_ERROR
+    const int result = inflate(&stream, Z_FINISH);
+    const uLong produced = stream.total_out;
+    inflateEnd(&stream);
+
+    if (result != Z_STREAM_END || produced != declared) {
+        qWarning() << "Rejecting compressed frame, declared size" << declared
+                   << (result == Z_STREAM_END ? "inflated size" : "zlib result")
+                   << (result == Z_STREAM_END ? static_cast<qint64>(produced) : static_cast<qint64>(result));
+        out.clear();
+        return false;
+    }
+    return true;
+}
+
+QByteArray MessageCodec::wrapRaw(const QByteArray& data)
+{
+    QByteArray frame;
+    frame.reserve(data.size() + 1);
+    frame.append(static_cast<char>(FrameTag::Raw));
+    frame.append(data);
+    return frame;
+}
+
+QByteArray MessageCodec::transferIdBytes(const QString& transferId)
+{
+    const QUuid uuid(transferId);
+    if (!uuid.isNull()) {
+        return uuid.toRfc4122();
+    }
+    return QCryptographicHash::hash(transferId.toUtf8(), QCryptographicHash::Md5);
+}
+
+quint32 MessageCodec::crc32(const char* data, qint64 size, quint32 crc)
+{
+    crc = ~crc;
+    const auto* p = reinterpret_cast<const uchar*>(data);
+    for (qint64 i = 0; i < size; ++i) {
+        crc = kCrcTable[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+QByteArray MessageCodec::encodeChunk(const QByteArray& transferId, quint64 offset, const char* data, int size)
+{
+    Q_ASSERT(transferId.size() == 16);
+
+    // 一次分配整帧，数据只复制这一次
+    QByteArray frame(kChunkHeaderSize + size, Qt::Uninitialized);
+    char* p = frame.data();
+    p[0] = static_cast<char>(FrameTag::Chunk);
+    memcpy(p + 1, transferId.constData(), 16);
+    qToBigEndian<quint64>(offset, p + 17);
+    qToBigEndian<quint32>(crc32(data, size), p + 25);
+    memcpy(p + kChunkHeaderSize, data, static_cast<size_t>(size));
+    return frame;
+}
+
+bool MessageCodec::decodeChunk(const QByteArray& frame, ChunkHeader& header, QByteArray& payload)
+{
+    if (frame.size() < kChunkHeaderSize || static_cast<quint8>(frame.at(0)) != static_cast<quint8>(FrameTag::Chunk)) {
+        return false;
+    }
+
+    const char* p = frame.constData();
+    header.transferId = QByteArray(p + 1, 16);
+    header.offset = qFromBigEndian<quint64>(p + 17);
+    header.crc = qFromBigEndian<quint32>(p + 25);
+    payload = QByteArray::fromRawData(p + kChunkHeaderSize, frame.size() - kChunkHeaderSize);
+    return crc32(payload.constData(), payload.size()) == header.crc;
+}
+
+JsonDocPtr MessageCodec::parseUtf8(const char* begin, const char* end)
+{
+    json message = json::parse(begin, end, nullptr, false);
+    if (message.is_discarded()) {
+        return nullptr;
+    }
+    return std::make_shared<const json>(std::move(message));
+}
+
+bool MessageCodec::decode(const QByteArray& frame, json& message, FrameTag& tag)
+{
+    if (frame.isEmpty()) {
+        return false;
+    }
+
+    const char* begin = frame.constData() + 1;
+    const char* end = frame.constData() + frame.size();
+
+    tag = static_cast<FrameTag>(static_cast<quint8>(frame.at(0)));
+    switch (tag) {
+    case FrameTag::Raw:
+        return true;
+    case FrameTag::Cbor:
+        message = json::from_cbor(begin, end, true, false);
+        break;
+    case FrameTag::MessagePack:
+        message = json::from_msgpack(begin, end, true, false);
+        break;
+    case FrameTag::Json:
+        message = json::parse(begin, end, nullptr, false);
+        break;
+    default:
+        return false;
+    }
+
+    return !message.is_discarded();
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMetaType>
+#include <QString>
+#include <functional>
+#include <memory>
+#include "third_party/nlohmann_json/include/nlohmann/json.hpp"
+
+using json = nlohmann::json;
+
+/**
+ * @brief 共享的只读消息文档
+ * 每帧只解析一次，所有订阅者共享同一份 DOM，跨线程/排队连接也只复制指针
+ */
+using JsonDocPtr = std::shared_ptr<const json>;
+Q_DECLARE_METATYPE(JsonDocPtr)
+
+/**
+ * @brief 预解码的业务模型（类型擦除）
+ * 由 ModelDecoder 在网络线程上从消息构造，随消息一起交给处理器
+ */
+using DecodedModel = std::shared_ptr<const void>;
+
+/// 模型解码函数：必须是无状态、线程安全的纯函数
+using ModelDecoder = std::function<DecodedModel(const json&)>;
+
+/**
+ * @brief 紧凑编码函数：发出前把完整消息转换为服务器在 sys.hello 中确认过的紧凑 schema
+ * binary 为 true 时线路编码能表示 bin（CBOR / MessagePack）；connection 每建立一次连接加一。
+ * 只在网络线程上调用，可以持有只在该线程访问的状态
+ */
+using CompactEncoder = std::function<json(const json& message, bool binary, quint64 connection)>;
+
+/**
+ * @brief 线路编码格式
+ * Json 走 text frame；Cbor / MessagePack 走 binary frame
+ */
+enum class WireFormat
+{
+    Json,
+    Cbor,
+    MessagePack
+};
+Q_DECLARE_METATYPE(WireFormat)
+
+/**
+ * @brief 二进制帧首字节标记
+ * 协商出二进制格式（或压缩）后，每个 binary frame 的第一个字节标识负载类型，
+ * 以便和 sendRawData 发送的原始数据区分。最高位（MessageCodec::kCompressedFlag）
+ * 表示其余部分经过 deflate 压缩
+ */
+enum class FrameTag : quint8
+{
+    Raw = 0x00,
+    Cbor = 0x01,
+    MessagePack = 0x02,
+    Json = 0x03,        // UTF-8 JSON 文本放在 binary frame 中，免去 UTF-16 转码
+    Chunk = 0x04        // 文件分块，无论线路编码如何都带此标记
+};
+
+/**
+ * @brief 文件分块帧头
+ * 帧布局（多字节整数均为大端）：
+ * FrameTag::Chunk(1) | transferId(16, RFC 4122 UUID) | offset(8) | crc32(4) | 数据
+ */
+struct ChunkHeader
+{
+    QByteArray transferId;      // 16 字节
+    quint64 offset = 0;
+    quint32 crc = 0;            // 数据部分的 CRC-32（IEEE 802.3）
+};
+Q_DECLARE_METATYPE(ChunkHeader)
+
+/**
+ * @brief 线路流量统计
+ * wireBytes 为实际收发的帧字节数，payloadBytes 为压缩前（解压后）的字节数；
+ * 两者之比即压缩率，*Nanos 为压缩/解压累计耗时
+ */
+struct WireStats
+{
+    quint64 framesOut = 0;
+    quint64 framesIn = 0;
+    quint64 wireBytesOut = 0;
+    quint64 wireBytesIn = 0;
+    quint64 payloadBytesOut = 0;
+    quint64 payloadBytesIn = 0;
+    quint64 compressedFramesOut = 0;
+    quint64 compressedFramesIn = 0;
+    quint64 compressNanos = 0;
+    quint64 decompressNanos = 0;
+};
+Q_DECLARE_METATYPE(WireStats)
+
+/**
+ * @brief 消息编解码
+ * 基于 nlohmann/json 自带的 CBOR / MessagePack 支持，直接写入 QByteArray，
+ * 避免 json -> std::string -> QString -> UTF-8 的多次转码
+ */
+namespace MessageCodec
+{
+    /// 协商时使用的格式名（"json" / "cbor" / "msgpack"）
+    QString formatName(WireFormat format);
+
+    /// 解析格式名，未知名称返回 false
+    bool formatFromName(const std::string& name, WireFormat& format);
+
+    /// 编码为带 FrameTag 的二进制帧（Json 编码为 FrameTag::Json + UTF-8 文本）
+    QByteArray encode(const json& message, WireFormat format);
+
+    /// 帧标记中表示压缩的最高位
+    constexpr quint8 kCompressedFlag = 0x80;
+
+    /// 解压后帧大小的上限，声明长度超过它的压缩帧直接拒绝
+    constexpr int kMaxDecompressedSize = 16 * 1024 * 1024;
+
+    /**
+     * @brief 压缩带 FrameTag 的帧
+     * 输出为 (tag | kCompressedFlag) + qCompress(其余部分)
+     * @return 压缩后不比原帧小时返回空
+     */
+    QByteArray compressFrame(const QByteArray& frame);
+
+    /**
+     * @brief 还原 compressFrame 的输出
+     * 用 zlib 流式解压到按声明长度分配的缓冲区，声明长度超过 maxSize、解压结果超出或不等于声明长度时拒绝，
+     * 内存占用不会超过 maxSize
+     * @return 格式不合法、超过上限或解压失败时返回 false
+     */
+    bool decompressFrame(const QByteArray& frame, QByteArray& out, int maxSize = kMaxDecompressedSize);
+
+    /// 为原始数据加上 FrameTag::Raw 前缀
+    QByteArray wrapRaw(const QByteArray& data);
+
+    /// 分块帧头长度（含 FrameTag）
+    constexpr int kChunkHeaderSize = 1 + 16 + 8 + 4;
+
+    /// 传输 ID 的 16 字节形式：UUID 取 RFC 4122 字节，其他字符串取 MD5
+    QByteArray transferIdBytes(const QString& transferId);
+
+    /// CRC-32（IEEE 802.3），crc 传入上一段的结果可以分段计算
+    quint32 crc32(const char* data, qint64 size, quint32 crc = 0);
+
+    /**
+     * @brief 编码文件分块帧
+     * @param transferId 16 字节传输 ID
+     * @param offset 数据在文件中的偏移
+     */
+    QByteArray encodeChunk(const QByteArray& transferId, quint64 offset, const char* data, int size);
+
+    /**
+     * @brief 解析文件分块帧头并校验 CRC
+     * @param payload 输出：数据部分（与 frame 共享内存）
+     * @return 帧格式合法且 CRC 一致返回 true
+     */
+    bool decodeChunk(const QByteArray& frame, ChunkHeader& header, QByteArray& payload);
+
+    /**
+     * @brief 直接从 UTF-8 字节解析 JSON（迭代器重载，不经过 std::string）
+     * @return 解析失败返回 nullptr
+     */
+    JsonDocPtr parseUtf8(const char* begin, const char* end);
+
+    /**
+     * @brief 解码二进制帧
+     * @param frame 带 FrameTag 的帧
+     * @param message 输出：解码后的消息（仅 Cbor / MessagePack / Json）
+     * @param tag 输出：帧标记
+     * @return 帧格式合法返回 true
+     */
+    bool decode(const QByteArray& frame, json& message, FrameTag& tag);
+}
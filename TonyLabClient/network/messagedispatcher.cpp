@@ -1,14 +1,177 @@
 #include "MessageDispatcher.h"
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QMetaMethod>
+#include <algorithm>
+
+MessageSubscription::MessageSubscription(MessageDispatcher* dispatcher, MessageTypeId typeId, quint64 id)
+    : m_dispatcher(dispatcher)
+    , m_typeId(typeId)
+    , m_id(id)
+{
+}
+
+MessageSubscription::MessageSubscription(MessageSubscription&& other) noexcept
+    : m_dispatcher(other.m_dispatcher)
+    , m_typeId(other.m_typeId)
+    , m_id(other.m_id)
+{
+    other.m_dispatcher.clear();
+    other.m_id = 0;
+}
+
+MessageSubscription& MessageSubscription::operator=(MessageSubscription&& other) noexcept
+{
+    if (this != &other) {
+        reset();
+        m_dispatcher = other.m_dispatcher;
+        m_typeId = other.m_typeId;
+        m_id = other.m_id;
+        other.m_dispatcher.clear();
+        other.m_id = 0;
+    }
+    return *this;
+}
+
+MessageSubscription::~MessageSubscription()
+{
+    reset();
+}
+
+void MessageSubscription::reset()
+{
+    if (m_dispatcher && m_id != 0) {
+        m_dispatcher->unsubscribe(m_typeId, m_id);
+    }
+    m_dispatcher.clear();
+    m_id = 0;
+}
 
 MessageDispatcher::MessageDispatcher(QObject* parent)
     : QObject(parent)
 {
+    // 已知类型的路由下标与 MessageTypes::KnownType 一一对应
+    m_routes.resize(MessageTypes::KnownTypeCount);
+    for (std::uint16_t i = 0; i < MessageTypes::KnownTypeCount; ++i) {
+        m_routes[i].stats.type = std::string(MessageTypes::kNames[i]);
+    }
+
+    // 默认通道：控制类消息优先，大批量回复排在最后
+    for (auto type : { MessageTypes::Heartbeat, MessageTypes::SysHello, MessageTypes::ImAck,
+                       MessageTypes::ImTyping, MessageTypes::DeviceControl, MessageTypes::DeviceStatus }) {
+        m_routes[type].lane = DispatchLane::High;
+    }
+    for (auto type : { MessageTypes::ImHistory, MessageTypes::ContactList, MessageTypes::GroupList }) {
+        m_routes[type].lane = DispatchLane::Bulk;
+    }
+
+    m_clock.start();
 }
 
 MessageDispatcher::~MessageDispatcher()
 {
-    m_handlers.clear();
+    m_legacyHandlers.clear();
+    for (auto& lane : m_lanes) {
+        lane.clear();
+    }
+    m_routes.clear();
+    m_typeIds.clear();
+}
+
+MessageTypeId MessageDispatcher::internType(const std::string& msgType)
+{
+    const MessageTypeId knownId = MessageTypes::lookup(msgType);
+    if (knownId != InvalidMessageTypeId) {
+        return knownId;
+    }
+
+    auto it = m_typeIds.find(msgType);
+    if (it != m_typeIds.end()) {
+        return it->second;
+    }
+
+    if (m_routes.size() >= InvalidMessageTypeId) {
+        qCritical() << "Too many message types registered";
+        return InvalidMessageTypeId;
+    }
+
+    const auto id = static_cast<MessageTypeId>(m_routes.size());
+    Route route;
+    route.stats.type = msgType;
+    m_routes.push_back(std::move(route));
+    m_typeIds.emplace(msgType, id);
+    return id;
+}
+
+MessageTypeId MessageDispatcher::typeId(const std::string& msgType) const
+{
+    const MessageTypeId knownId = MessageTypes::lookup(msgType);
+    if (knownId != InvalidMessageTypeId) {
+        return knownId;
+    }
+
+    auto it = m_typeIds.find(msgType);
+    return it != m_typeIds.end() ? it->second : InvalidMessageTypeId;
+}
+
+MessageSubscription MessageDispatcher::subscribe(const std::string& msgType, MessageHandler handler)
+{
+    if (!handler) {
+        qWarning() << "Cannot subscribe null handler for message type:" << QString::fromStdString(msgType);
+        return MessageSubscription();
+    }
+
+    const MessageTypeId id = internType(msgType);
+    if (id == InvalidMessageTypeId) {
+        return MessageSubscription();
+    }
+
+    Subscriber subscriber;
+    subscriber.id = m_nextSubscriberId++;
+    subscriber.handler = std::move(handler);
+    m_routes[id].subscribers.push_back(std::move(subscriber));
+    ++m_routes[id].stats.subscribers;
+
+    qDebug() << "Subscribed to message type:" << QString::fromStdString(msgType)
+             << "id:" << id << "subscribers:" << m_routes[id].stats.subscribers;
+    return MessageSubscription(this, id, m_routes[id].subscribers.back().id);
+}
+
+void MessageDispatcher::unsubscribe(MessageTypeId typeId, quint64 id)
+{
+    if (typeId >= m_routes.size()) {
+        return;
+    }
+
+    Route& route = m_routes[typeId];
+    for (auto& subscriber : route.subscribers) {
+        if (subscriber.id == id && subscriber.active) {
+            // 分发过程中只做标记，等分发结束再真正移除，保证遍历下标稳定
+            subscriber.active = false;
+            --route.stats.subscribers;
+            m_needsCompact = true;
+            break;
+        }
+    }
+
+    if (m_dispatchDepth == 0) {
+        compactRoutes();
+    }
+}
+
+void MessageDispatcher::compactRoutes()
+{
+    if (!m_needsCompact) {
+        return;
+    }
+
+    for (auto& route : m_routes) {
+        auto& subs = route.subscribers;
+        subs.erase(std::remove_if(subs.begin(), subs.end(),
+                                  [](const Subscriber& s) { return !s.active; }),
+                   subs.end());
+    }
+    m_needsCompact = false;
 }
 
 void MessageDispatcher::registerHandler(const std::string& msgType, MessageHandler handler)
@@ -17,56 +180,263 @@ void MessageDispatcher::registerHandler(const std::string& msgType, MessageHandl
         qWarning() << "Cannot register null handler for message type:" << QString::fromStdString(msgType);
         return;
     }
-    
-    m_handlers[msgType] = handler;
-    qDebug() << "Handler registered for message type:" << QString::fromStdString(msgType);
+
+    MessageSubscription subscription = subscribe(msgType, std::move(handler));
+    if (subscription.isActive()) {
+        m_legacyHandlers[subscription.m_typeId] = std::move(subscription);
+    }
 }
 
 void MessageDispatcher::unregisterHandler(const std::string& msgType)
 {
-    auto it = m_handlers.find(msgType);
-    if (it != m_handlers.end()) {
-        m_handlers.erase(it);
+    const MessageTypeId id = typeId(msgType);
+    auto it = m_legacyHandlers.find(id);
+    if (it != m_legacyHandlers.end()) {
+        m_legacyHandlers.erase(it);
         qDebug() << "Handler unregistered for message type:" << QString::fromStdString(msgType);
     }
 }
 
+void MessageDispatcher::setLane(const std::string& msgType, DispatchLane lane)
+{
+    const MessageTypeId id = internType(msgType);
+    if (id != InvalidMessageTypeId) {
+        m_routes[id].lane = lane;
+    }
+}
+
+bool MessageDispatcher::resolveType(const json& message, MessageTypeId& id, std::string& dynamicType) const
+{
+    // 消息格式为 {"type": "auth.login", ...} 或 {"module": "auth", "action": "login", ...}
+    // 已知类型直接在 json 内部字符串上查完美哈希表，只有未知类型才构造 std::string
+    auto typeIt = message.find("type");
+    if (typeIt != message.end() && typeIt->is_string()) {
+        const std::string& type = typeIt->get_ref<const std::string&>();
+        id = MessageTypes::lookup(type);
+        if (id == InvalidMessageTypeId) {
+            dynamicType = type;
+            id = typeId(dynamicType);
+        }
+        return true;
+    }
+
+    auto moduleIt = message.find("module");
+    auto actionIt = message.find("action");
+    if (moduleIt != message.end() && actionIt != message.end()
+        && moduleIt->is_string() && actionIt->is_string()) {
+        const std::string& module = moduleIt->get_ref<const std::string&>();
+        const std::string& action = actionIt->get_ref<const std::string&>();
+        id = MessageTypes::lookup(module, action);
+        if (id == InvalidMessageTypeId) {
+            dynamicType = module + "." + action;
+            id = typeId(dynamicType);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+QString MessageDispatcher::typeName(MessageTypeId id, const std::string& dynamicType) const
+{
+    if (id < MessageTypes::KnownTypeCount) {
+        const std::string_view name = MessageTypes::kNames[id];
+        return QString::fromUtf8(name.data(), static_cast<int>(name.size()));
+    }
+    return QString::fromStdString(dynamicType);
+}
+
 void MessageDispatcher::dispatch(const json& message)
 {
+    MessageTypeId id = InvalidMessageTypeId;
+    std::string dynamicType;
+
     try {
-        // 从消息中提取类型 (假设格式为 {"type": "auth.login", ...} 或 {"module": "auth", "action": "login", ...})
-        std::string msgType;
-        
-        if (message.contains("type") && message["type"].is_string()) {
-            msgType = message["type"].get<std::string>();
-        } else if (message.contains("module") && message.contains("action")) {
-            msgType = message["module"].get<std::string>() + "." + message["action"].get<std::string>();
-        } else {
+        if (!resolveType(message, id, dynamicType)) {
             qWarning() << "Message does not contain 'type' or 'module'/'action' fields";
             emit dispatchError("unknown", "Missing message type");
             return;
         }
-        
-        auto it = m_handlers.find(msgType);
-        if (it != m_handlers.end()) {
-            it->second(message);
-            qDebug() << "Message dispatched to handler:" << QString::fromStdString(msgType);
-            emit messageDispatched(QString::fromStdString(msgType));
-        } else {
-            qWarning() << "No handler registered for message type:" << QString::fromStdString(msgType);
-            emit dispatchError(QString::fromStdString(msgType), "No handler registered");
+    } catch (const std::exception& e) {
+        qCritical() << "Dispatch error:" << e.what();
+        emit dispatchError("unknown", QString::fromStdString(e.what()));
+        return;
+    }
+
+    // 同步分发不带预解码模型
+    DecodedModel outerModel = std::move(m_currentModel);
+    deliver(id, message, dynamicType);
+    m_currentModel = std::move(outerModel);
+}
+
+void MessageDispatcher::deliver(MessageTypeId id, const json& message, const std::string& dynamicType)
+{
+    if (id == InvalidMessageTypeId || m_routes[id].stats.subscribers == 0) {
+        qDebug() << "No handler registered for message type:" << typeName(id, dynamicType);
+        emit dispatchError(typeName(id, dynamicType), "No handler registered");
+        return;
+    }
+
+    Route& route = m_routes[id];
+
+    QElapsedTimer timer;
+    timer.start();
+
+    ++m_dispatchDepth;
+    // 只遍历分发开始时已有的订阅者；处理器中新增的订阅从下一条消息开始生效
+    const std::size_t count = route.subscribers.size();
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!route.subscribers[i].active) {
+            continue;
+        }
+
+        // 处理器执行期间可能增删订阅，先取副本再调用（只捕获 this 的 lambda 不会分配内存）
+        const MessageHandler handler = route.subscribers[i].handler;
+        try {
+            handler(message);
+        } catch (const std::exception& e) {
+            qCritical() << "Dispatch error:" << typeName(id, dynamicType) << e.what();
+            emit dispatchError(typeName(id, dynamicType), QString::fromStdString(e.what()));
+        }
+    }
+    --m_dispatchDepth;
+
+    const qint64 elapsed = timer.nsecsElapsed();
+    RouteStats& stats = route.stats;
+    ++stats.count;
+    stats.totalNs += elapsed;
+    stats.maxNs = qMax(stats.maxNs, elapsed);
+
+    if (m_dispatchDepth == 0) {
+        compactRoutes();
+    }
+
+    // 没有监听者时不构造 QString
+    static const QMetaMethod dispatchedSignal = QMetaMethod::fromSignal(&MessageDispatcher::messageDispatched);
+    if (isSignalConnected(dispatchedSignal)) {
+        emit messageDispatched(typeName(id, dynamicType));
+    }
+}
+
+void MessageDispatcher::dispatchDocument(const JsonDocPtr& document)
+{
+    if (document) {
+        dispatch(*document);
+    }
+}
+
+void MessageDispatcher::post(const JsonDocPtr& document, DecodedModel model)
+{
+    if (!document) {
+        return;
+    }
+
+    Pending pending;
+    try {
+        if (!resolveType(*document, pending.id, pending.dynamicType)) {
+            qWarning() << "Message does not contain 'type' or 'module'/'action' fields";
+            emit dispatchError("unknown", "Missing message type");
+            return;
         }
     } catch (const std::exception& e) {
         qCritical() << "Dispatch error:" << e.what();
         emit dispatchError("unknown", QString::fromStdString(e.what()));
+        return;
+    }
+
+    const DispatchLane lane = pending.id != InvalidMessageTypeId
+        ? m_routes[pending.id].lane : DispatchLane::Normal;
+
+    pending.document = document;
+    pending.model = std::move(model);
+    pending.enqueuedNs = m_clock.nsecsElapsed();
+    m_lanes[static_cast<int>(lane)].push_back(std::move(pending));
+
+    scheduleDrain();
+}
+
+int MessageDispatcher::pendingCount() const
+{
+    int count = 0;
+    for (const auto& lane : m_lanes) {
+        count += static_cast<int>(lane.size());
+    }
+    return count;
+}
+
+void MessageDispatcher::scheduleDrain()
+{
+    if (m_drainScheduled) {
+        return;
+    }
+
+    m_drainScheduled = true;
+    QMetaObject::invokeMethod(this, [this]() { drainQueues(); }, Qt::QueuedConnection);
+}
+
+void MessageDispatcher::drainQueues()
+{
+    m_drainScheduled = false;
+
+    auto& high = m_lanes[static_cast<int>(DispatchLane::High)];
+    auto& normal = m_lanes[static_cast<int>(DispatchLane::Normal)];
+    auto& bulk = m_lanes[static_cast<int>(DispatchLane::Bulk)];
+
+    auto runOne = [this](std::deque<Pending>& lane) {
+        Pending pending = std::move(lane.front());
+        lane.pop_front();
+
+        if (pending.id != InvalidMessageTypeId) {
+            RouteStats& stats = m_routes[pending.id].stats;
+            stats.maxWaitNs = qMax(stats.maxWaitNs, m_clock.nsecsElapsed() - pending.enqueuedNs);
+        }
+        // 嵌套分发（处理器内同步 dispatch）结束后恢复外层模型
+        DecodedModel outerModel = std::move(m_currentModel);
+        m_currentModel = std::move(pending.model);
+        deliver(pending.id, *pending.document, pending.dynamicType);
+        m_currentModel = std::move(outerModel);
+    };
+
+    while (!high.empty() || !normal.empty()) {
+        runOne(!high.empty() ? high : normal);
+    }
+
+    if (!bulk.empty()) {
+        // 每轮只处理一条大批量消息，然后让出事件循环，让刚到达的高优先级帧插队
+        runOne(bulk);
+        if (pendingCount() > 0) {
+            scheduleDrain();
+        }
     }
 }
 
 std::vector<std::string> MessageDispatcher::getRegisteredTypes() const
 {
     std::vector<std::string> types;
-    for (const auto& pair : m_handlers) {
-        types.push_back(pair.first);
+    for (const auto& route : m_routes) {
+        if (route.stats.subscribers > 0) {
+            types.push_back(route.stats.type);
+        }
     }
     return types;
 }
+
+std::vector<RouteStats> MessageDispatcher::routeStats() const
+{
+    std::vector<RouteStats> stats;
+    stats.reserve(m_routes.size());
+    for (const auto& route : m_routes) {
+        stats.push_back(route.stats);
+    }
+    return stats;
+}
+
+void MessageDispatcher::resetStats()
+{
+    for (auto& route : m_routes) {
+        route.stats.count = 0;
+        route.stats.totalNs = 0;
+        route.stats.maxNs = 0;
+        route.stats.maxWaitNs = 0;
+    }
+}
@@ -1,59 +1,237 @@
 #pragma once
 
+#include <QElapsedTimer>
 #include <QObject>
+#include <QPointer>
 #include "third_party/nlohmann_json/include/nlohmann/json.hpp"
+#include "messagecodec.h"
+#include "messagetypes.h"
+#include <cstdint>
+#include <deque>
 #include <unordered_map>
 #include <functional>
 #include <memory>
+#include <vector>
 
 using json = nlohmann::json;
 
 // 消息处理回调类型
 using MessageHandler = std::function<void(const json&)>;
 
+// 消息类型 ID（路由表下标）：已知类型即 MessageTypes::KnownType，动态类型注册时顺序分配
+using MessageTypeId = std::uint16_t;
+constexpr MessageTypeId InvalidMessageTypeId = MessageTypes::kNotFound;
+
+/**
+ * @brief 分发优先级通道
+ * 同一轮事件循环内排队的消息按 High -> Normal -> Bulk 顺序处理，
+ * Bulk 每处理一条就让出事件循环，避免大批量回复挡住 ack / typing / 设备控制
+ */
+enum class DispatchLane
+{
+    High,
+    Normal,
+    Bulk
+};
+
+/**
+ * @brief 单条路由的统计信息
+ */
+struct RouteStats
+{
+    std::string type;        // 消息类型
+    quint64 count = 0;       // 分发次数
+    qint64 totalNs = 0;      // 处理器累计耗时（纳秒）
+    qint64 maxNs = 0;        // 处理器单次最大耗时（纳秒）
+    qint64 maxWaitNs = 0;    // 在通道队列中的最大等待时间（纳秒）
+    int subscribers = 0;     // 当前订阅者数量
+};
+
+class MessageDispatcher;
+
+/**
+ * @brief 订阅凭证
+ * 只能移动不能复制，析构时自动取消订阅；分发器先于凭证销毁也是安全的
+ */
+class MessageSubscription
+{
+public:
+    MessageSubscription() = default;
+    MessageSubscription(MessageSubscription&& other) noexcept;
+    MessageSubscription& operator=(MessageSubscription&& other) noexcept;
+    MessageSubscription(const MessageSubscription&) = delete;
+    MessageSubscription& operator=(const MessageSubscription&) = delete;
+    ~MessageSubscription();
+
+    /// 取消订阅
+    void reset();
+
+    /// 是否仍处于订阅状态
+    bool isActive() const { return !m_dispatcher.isNull() && m_id != 0; }
+
+private:
+    friend class MessageDispatcher;
+    MessageSubscription(MessageDispatcher* dispatcher, MessageTypeId typeId, quint64 id);
+
+    QPointer<MessageDispatcher> m_dispatcher;
+    MessageTypeId m_typeId = InvalidMessageTypeId;
+    quint64 m_id = 0;
+};
+
 /**
  * @brief 消息分发器
  * 根据消息类型或模块路由消息到对应的处理器
+ * 每帧只解析一次、只分发一次：类型在注册时被分配为整数 ID。
+ * 已知类型通过编译期完美哈希（MessageTypes）直接定位路由表下标，分发过程不分配内存；
+ * 动态类型走运行时映射兜底
+ * 每个类型可以有多个订阅者，按订阅顺序依次调用
  */
 class MessageDispatcher : public QObject
 {
     Q_OBJECT
-    
+
 public:
     explicit MessageDispatcher(QObject* parent = nullptr);
     ~MessageDispatcher();
-    
+
     /**
-     * @brief 注册消息处理器
+     * @brief 订阅消息
      * @param msgType 消息类型（如 "auth.login", "im.message"）
      * @param handler 处理函数
+     * @return 订阅凭证，凭证析构即取消订阅（返回值需保存）
+     */
+    [[nodiscard]] MessageSubscription subscribe(const std::string& msgType, MessageHandler handler);
+
+    /**
+     * @brief 注册消息处理器（兼容旧接口）
+     * 每个类型只保留一个经此接口注册的处理器，重复注册会替换；
+     * 与 subscribe 注册的订阅者互不影响
+     * @param msgType 消息类型
+     * @param handler 处理函数
      */
     void registerHandler(const std::string& msgType, MessageHandler handler);
-    
+
     /**
-     * @brief 移除消息处理器
+     * @brief 移除经 registerHandler 注册的处理器
      * @param msgType 消息类型
      */
     void unregisterHandler(const std::string& msgType);
-    
+
+    /**
+     * @brief 设置消息类型所属的优先级通道
+     * 默认：heartbeat、im.ack、im.typing、device.control/status 为 High；
+     * im.history、contact.list、group.list 为 Bulk；其余为 Normal
+     */
+    void setLane(const std::string& msgType, DispatchLane lane);
+
     /**
-     * @brief 分发消息
+     * @brief 分配（或查询已有的）消息类型 ID
+     */
+    MessageTypeId internType(const std::string& msgType);
+
+    /**
+     * @brief 查询消息类型 ID，未注册返回 InvalidMessageTypeId
+     */
+    MessageTypeId typeId(const std::string& msgType) const;
+
+    /**
+     * @brief 立即分发消息（不经过优先级通道）
      * @param message JSON 消息对象
      */
     void dispatch(const json& message);
-    
+
+    /**
+     * @brief 分发共享文档（连接 WebSocketClient::documentReceived）
+     */
+    void dispatchDocument(const JsonDocPtr& document);
+
+    /**
+     * @brief 按优先级通道排队，在本轮事件循环结束后分发
+     * @param model 网络线程预解码的业务模型，处理器内通过 currentModel<T>() 取用
+     */
+    void post(const JsonDocPtr& document, DecodedModel model = DecodedModel());
+
+    /**
+     * @brief 当前正在分发的消息附带的预解码模型
+     * 只在处理器执行期间有效；没有模型（同步 dispatch 或未注册解码器）时返回空指针，
+     * 调用方应回退到自行解析 json
+     */
+    template <typename T>
+    std::shared_ptr<const T> currentModel() const
+    {
+        return std::static_pointer_cast<const T>(m_currentModel);
+    }
+
+    /**
+     * @brief 各通道中尚未分发的消息数
+     */
+    int pendingCount() const;
+
     /**
      * @brief 获取已注册的消息类型列表
      */
     std::vector<std::string> getRegisteredTypes() const;
-    
+
+    /**
+     * @brief 获取每条路由的分发次数与耗时
+     */
+    std::vector<RouteStats> routeStats() const;
+
+    /**
+     * @brief 清零统计
+     */
+    void resetStats();
+
 signals:
     /// 消息分发时发出错误
     void dispatchError(const QString& msgType, const QString& error);
-    
+
     /// 消息分发成功
     void messageDispatched(const QString& msgType);
-    
+
 private:
-    std::unordered_map<std::string, MessageHandler> m_handlers;
+    friend class MessageSubscription;
+
+    struct Subscriber
+    {
+        quint64 id = 0;
+        MessageHandler handler;
+        bool active = true;
+    };
+
+    struct Route
+    {
+        std::vector<Subscriber> subscribers;
+        DispatchLane lane = DispatchLane::Normal;
+        RouteStats stats;
+    };
+
+    struct Pending
+    {
+        MessageTypeId id = InvalidMessageTypeId;
+        JsonDocPtr document;
+        DecodedModel model;
+        std::string dynamicType;
+        qint64 enqueuedNs = 0;
+    };
+
+    bool resolveType(const json& message, MessageTypeId& id, std::string& dynamicType) const;
+    QString typeName(MessageTypeId id, const std::string& dynamicType) const;
+    void deliver(MessageTypeId id, const json& message, const std::string& dynamicType);
+    void unsubscribe(MessageTypeId typeId, quint64 id);
+    void compactRoutes();
+    void scheduleDrain();
+    void drainQueues();
+
+    std::unordered_map<std::string, MessageTypeId> m_typeIds;     // 仅动态类型
+    std::deque<Route> m_routes;     // deque：处理器内注册新类型时不会使路由引用失效
+    std::unordered_map<MessageTypeId, MessageSubscription> m_legacyHandlers;
+    quint64 m_nextSubscriberId = 1;
+    int m_dispatchDepth = 0;
+    bool m_needsCompact = false;
+
+    std::deque<Pending> m_lanes[3];
+    bool m_drainScheduled = false;
+    QElapsedTimer m_clock;
+    DecodedModel m_currentModel;
 };
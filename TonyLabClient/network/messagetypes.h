@@ -0,0 +1,177 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief 已知消息类型表
+ * 编译期为 auth.* / im.* / contact.* / group.* / device.* 等固定类型生成完美哈希，
+ * 分发时直接在 json 内部字符串上查表，不分配内存；
+ * 不在表中的类型由 MessageDispatcher 的运行时映射兜底
+ *
+ * 新增协议类型时追加到 KnownType 与 kNames（两者顺序一致），static_assert 会检查冲突
+ */
+namespace MessageTypes
+{
+    enum KnownType : std::uint16_t
+    {
+        Heartbeat,
+        SysHello,
+
+        AuthLogin,
+        AuthLogout,
+
+        ImMessage,
+        ImAck,
+        ImTyping,
+        ImHistory,
+        ImFile,
+
+        ContactList,
+        ContactStatus,
+        ContactManage,
+        ContactDelta,
+
+        GroupList,
+        GroupUpdate,
+        GroupManage,
+
+        DeviceList,
+        DeviceStatus,
+        DeviceControl,
+        DeviceTelemetry,
+
+        KnownTypeCount
+    };
+
+    constexpr std::array<std::string_view, KnownTypeCount> kNames = {
+        "heartbeat",
+        "sys.hello",
+
+        "auth.login",
+        "auth.logout",
+
+        "im.message",
+        "im.ack",
+        "im.typing",
+        "im.history",
+        "im.file",
+
+        "contact.list",
+        "contact.status",
+        "contact.manage",
+        "contact.delta",
+
+        "group.list",
+        "group.update",
+        "group.manage",
+
+        "device.list",
+        "device.status",
+        "device.control",
+        "device.telemetry",
+    };
+
+    constexpr std::uint16_t kNotFound = 0xFFFF;
+
+    namespace detail
+    {
+        constexpr std::size_t kTableSize = 128;     // 2 的幂，约为类型数的 4 倍以上
+        constexpr std::uint32_t kTableMask = kTableSize - 1;
+
+        // FNV-1a，可逐段追加，便于 module + "." + action 不拼接直接计算
+        constexpr std::uint32_t hashAppend(std::uint32_t h, std::string_view s)
+        {
+            for (char c : s) {
+                h ^= static_cast<std::uint8_t>(c);
+                h *= 16777619u;
+            }
+            return h;
+        }
+
+        constexpr std::uint32_t hashSeed(std::uint32_t seed)
+        {
+            return 2166136261u ^ (seed * 0x9E3779B9u);
+        }
+
+        constexpr bool seedIsPerfect(std::uint32_t seed)
+        {
+            std::array<bool, kTableSize> used{};
+            for (std::string_view name : kNames) {
+                const std::uint32_t slot = hashAppend(hashSeed(seed), name) & kTableMask;
+                if (used[slot]) {
+                    return false;
+                }
+                used[slot] = true;
+            }
+            return true;
+        }
+
+        constexpr std::uint32_t findSeed()
+        {
+            for (std::uint32_t seed = 0; seed < 100000; ++seed) {
+                if (seedIsPerfect(seed)) {
+                    return seed;
+                }
+            }
+            return 0xFFFFFFFFu;
+        }
+
+        constexpr std::uint32_t kSeed = findSeed();
+        static_assert(kSeed != 0xFFFFFFFFu, "no perfect hash seed found, enlarge kTableSize");
+
+        constexpr std::array<std::uint16_t, kTableSize> buildTable()
+        {
+            std::array<std::uint16_t, kTableSize> table{};
+            for (auto& slot : table) {
+                slot = kNotFound;
+            }
+            for (std::uint16_t i = 0; i < KnownTypeCount; ++i) {
+                table[hashAppend(hashSeed(kSeed), kNames[i]) & kTableMask] = i;
+            }
+            return table;
+        }
+
+        constexpr std::array<std::uint16_t, kTableSize> kTable = buildTable();
+    }
+
+    /**
+     * @brief 查找已知类型
+     * @return KnownType 下标，未知返回 kNotFound
+     */
+    constexpr std::uint16_t lookup(std::string_view type)
+    {
+        const std::uint32_t slot = detail::hashAppend(detail::hashSeed(detail::kSeed), type) & detail::kTableMask;
+        const std::uint16_t index = detail::kTable[slot];
+        return (index != kNotFound && kNames[index] == type) ? index : kNotFound;
+    }
+
+    /**
+     * @brief 按 module / action 两段查找（等价于 lookup(module + "." + action)，不拼接字符串）
+     */
+    constexpr std::uint16_t lookup(std::string_view module, std::string_view action)
+    {
+        std::uint32_t h = detail::hashAppend(detail::hashSeed(detail::kSeed), module);
+        h = detail::hashAppend(h, ".");
+        h = detail::hashAppend(h, action);
+
+        const std::uint16_t index = detail::kTable[h & detail::kTableMask];
+        if (index == kNotFound) {
+            return kNotFound;
+        }
+
+        const std::string_view name = kNames[index];
+        if (name.size() != module.size() + 1 + action.size()
+            || name.substr(0, module.size()) != module
+            || name[module.size()] != '.'
+            || name.substr(module.size() + 1) != action) {
+            return kNotFound;
+        }
+        return index;
+    }
+
+    static_assert(lookup("im.message") == ImMessage, "perfect hash table is inconsistent");
+    static_assert(lookup("device", "control") == DeviceControl, "perfect hash table is inconsistent");
+    static_assert(lookup("im.unknown") == kNotFound, "perfect hash table is inconsistent");
+}
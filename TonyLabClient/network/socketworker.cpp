@@ -0,0 +1,767 @@
+#include "SocketWorker.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QTimerEvent>
+#include <QUrl>
+#include <algorithm>
+
+SocketWorker::SocketWorker(QObject* parent)
+    : QObject(parent)
+    , m_webSocket(new QWebSocket(QString(), QWebSocketProtocol::VersionLatest, this))
+{
+    connect(m_webSocket, &QWebSocket::connected,
+            this, &SocketWorker::onConnected);
+
+    connect(m_webSocket, &QWebSocket::disconnected,
+            this, &SocketWorker::onDisconnected);
+
+    connect(m_webSocket,
+            static_cast<void(QWebSocket::*)(QAbstractSocket::SocketError)>(&QWebSocket::error),
+            this, &SocketWorker::onError);
+
+    connect(m_webSocket, &QWebSocket::textMessageReceived,
+            this, &SocketWorker::onTextMessageReceived);
+
+    connect(m_webSocket, &QWebSocket::binaryMessageReceived,
+            this, &SocketWorker::onBinaryMessageReceived);
+
+    connect(m_webSocket, &QWebSocket::bytesWritten,
+            this, &SocketWorker::onBytesWritten);
+}
+
+SocketWorker::~SocketWorker()
+{
+}
+
+void SocketWorker::shutdown()
+{
+    stopAutoReconnectTimer();
+    m_autoReconnect = false;
+
+    if (m_webSocket->isValid()) {
+        m_webSocket->close();
+    }
+}
+
+void SocketWorker::connectToServer(const QString& url)
+{
+    m_serverUrl = url;
+
+    if (m_webSocket->isValid()) {
+        m_webSocket->close();
+    }
+
+    qDebug() << "Connecting to WebSocket server:" << url;
+    m_webSocket->open(QUrl(url));
+}
+
+void SocketWorker::disconnectFromServer()
+{
+    stopAutoReconnectTimer();
+
+    // 主动断开时丢弃未发送的消息，避免下次连接（可能是另一个账号）发出过期内容
+    clearOutbox();
+
+    if (m_webSocket->isValid()) {
+        m_webSocket->close();
+    }
+}
+
+namespace
+{
+    constexpr int kMaxBatchMessages = 32;
+
+    // 未指定合并键时按消息语义推断：输入状态只保留每个会话的最新一条
+    std::string defaultCoalesceKey(const json& message)
+    {
+        auto typeIt = message.find("type");
+        if (typeIt == message.end() || !typeIt->is_string()
+            || typeIt->get_ref<const std::string&>() != "im.typing") {
+            return std::string();
+        }
+
+        auto targetIt = message.find("targetId");
+        if (targetIt == message.end() || !targetIt->is_string()) {
+            return std::string();
+        }
+        return "im.typing/" + targetIt->get_ref<const std::string&>();
+    }
+}
+
+void SocketWorker::sendMessage(const json& message, const std::string& coalesceKey)
+{
+    Outbound item;
+    item.message = message;
+    item.coalesceKey = coalesceKey.empty() ? defaultCoalesceKey(message) : coalesceKey;
+    enqueueOutbound(std::move(item));
+}
+
+void SocketWorker::sendReplayableMessage(const json& message)
+{
+    // 未连接时不入队：连接建立后上层发件箱会重放
+    if (!m_isConnected) {
+        return;
+    }
+
+    Outbound item;
+    item.message = message;
+    item.replayable = true;
+    enqueueOutbound(std::move(item));
+}
+
+void SocketWorker::sendRawData(const QByteArray& data)
+{
+    Outbound item;
+    item.raw = data;
+    item.isRaw = true;
+    enqueueOutbound(std::move(item));
+}
+
+void SocketWorker::sendBulkData(const QByteArray& frame)
+{
+    if (!m_isConnected) {
+        return;
+    }
+
+    m_bulkOutbox.push_back(frame);
+    scheduleSendFlush();
+}
+
+void SocketWorker::enqueueOutbound(Outbound item)
+{
+    if (!item.coalesceKey.empty()) {
+        auto it = m_coalesceIndex.find(item.coalesceKey);
+        if (it != m_coalesceIndex.end()) {
+            // 队列里还有同键的旧消息：原位替换，保持发送顺序
+            m_outbox[static_cast<std::size_t>(it->second - m_outboxBaseSeq)] = std::move(item);
+            return;
+        }
+    }
+
+    if (static_cast<int>(m_outbox.size()) >= m_maxQueuedMessages) {
+        qWarning() << "Send queue full, dropping message";
+        setBufferFull(true);
+        emit error(QStringLiteral("Send queue full"));
+        return;
+    }
+
+    if (!m_isConnected && m_outbox.empty()) {
+        qDebug() << "WebSocket not connected, message queued until reconnect";
+    }
+
+    if (!item.coalesceKey.empty()) {
+        m_coalesceIndex.emplace(item.coalesceKey, m_outboxBaseSeq + m_outbox.size());
+    }
+    m_outbox.push_back(std::move(item));
+    scheduleSendFlush();
+}
+
+void SocketWorker::scheduleSendFlush()
+{
+    if (m_sendFlushScheduled || !m_isConnected) {
+        return;
+    }
+
+    // 同一轮事件循环内的发送合并后一次写出，才有机会批量打包
+    m_sendFlushScheduled = true;
+    QMetaObject::invokeMethod(this, [this]() { flushOutbox(); }, Qt::QueuedConnection);
+}
+
+void SocketWorker::flushOutbox()
+{
+    m_sendFlushScheduled = false;
+
+    while (m_isConnected && !m_outbox.empty()) {
+        if (m_webSocket->bytesToWrite() >= m_highWaterBytes) {
+            // 等 bytesWritten 把缓冲降到低水位再继续
+            setBufferFull(true);
+            return;
+        }
+
+        // 连续的 JSON 消息在服务器支持时打包成一个批量信封
+        std::size_t count = 0;
+        while (count < m_outbox.size() && count < static_cast<std::size_t>(kMaxBatchMessages)
+               && !m_outbox[count].isRaw) {
+            ++count;
+        }
+        if (!m_batchSupported || count < 2) {
+            count = 1;
+        }
+
+        try {
+            if (m_outbox.front().isRaw) {
+                const QByteArray& data = m_outbox.front().raw;
+                writeBinary(framesTagged() ? MessageCodec::wrapRaw(data) : data, false);
+            } else if (count == 1) {
+                encodeCompact(m_outbox.front().message);
+                writeMessage(m_outbox.front().message);
+            } else {
+                json envelope = {
+                    {"type", "batch"},
+                    {"messages", json::array()}
+                };
+                json& messages = envelope["messages"];
+                for (std::size_t i = 0; i < count; ++i) {
+                    encodeCompact(m_outbox[i].message);
+                    messages.push_back(std::move(m_outbox[i].message));
+                }
+                writeMessage(envelope);
+            }
+        } catch (const std::exception& e) {
+            qCritical() << "Failed to send message:" << e.what();
+            emit error(QString::fromStdString(e.what()));
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const Outbound& sent = m_outbox.front();
+            if (!sent.coalesceKey.empty()) {
+                m_coalesceIndex.erase(sent.coalesceKey);
+            }
+            m_outbox.pop_front();
+            ++m_outboxBaseSeq;
+        }
+    }
+
+    // 普通消息全部写出后才轮到分块，且只把套接字缓冲填到 m_bulkBufferLimit
+    while (m_isConnected && m_outbox.empty() && !m_bulkOutbox.empty()
+           && m_webSocket->bytesToWrite() < m_bulkBufferLimit) {
+        writeBinary(m_bulkOutbox.front(), false);
+        m_bulkOutbox.pop_front();
+    }
+
+    if (m_webSocket->bytesToWrite() < m_highWaterBytes / 2
+        && static_cast<int>(m_outbox.size()) < m_maxQueuedMessages) {
+        setBufferFull(false);
+    }
+}
+
+void SocketWorker::encodeCompact(json& message) const
+{
+    if (m_compactTypes.empty()) {
+        return;
+    }
+
+    auto typeIt = message.find("type");
+    if (typeIt == message.end() || !typeIt->is_string()) {
+        return;
+    }
+    const std::string type = typeIt->get<std::string>();
+    if (m_compactTypes.count(type) == 0) {
+        return;
+    }
+    auto encoderIt = m_compactEncoders.find(type);
+    if (encoderIt == m_compactEncoders.end()) {
+        return;
+    }
+
+    // 发出时按当前线路编码转换，排队期间协商结果变化也不会写出对端不认识的形式
+    json compact = encoderIt->second(message, m_wireFormat != WireFormat::Json, m_connectionSerial);
+    compact["type"] = type;
+    message = std::move(compact);
+}
+
+void SocketWorker::writeMessage(const json& message)
+{
+    if (m_wireFormat != WireFormat::Json) {
+        writeBinary(MessageCodec::encode(message, m_wireFormat), true);
+        return;
+    }
+
+    // text JSON 模式下超过阈值的消息改用压缩的 FrameTag::Json binary frame
+    const std::string jsonStr = message.dump();
+    if (m_compressionActive && static_cast<qint64>(jsonStr.size()) >= m_compressionThreshold) {
+        QByteArray frame;
+        frame.reserve(static_cast<int>(jsonStr.size()) + 1);
+        frame.append(static_cast<char>(FrameTag::Json));
+        frame.append(jsonStr.data(), static_cast<int>(jsonStr.size()));
+        writeBinary(frame, true);
+        return;
+    }
+    writeText(jsonStr);
+}
+
+void SocketWorker::writeText(const std::string& text)
+{
+    m_webSocket->sendTextMessage(QString::fromUtf8(text.data(), static_cast<int>(text.size())));
+
+    QMutexLocker locker(&m_statsMutex);
+    ++m_stats.framesOut;
+    m_stats.wireBytesOut += text.size();
+    m_stats.payloadBytesOut += text.size();
+}
+
+void SocketWorker::writeBinary(const QByteArray& frame, bool compressible)
+{
+    // 原始数据和文件分块通常已经压缩过，不再尝试
+    QByteArray compressed;
+    qint64 nanos = 0;
+    if (compressible && m_compressionActive && frame.size() >= m_compressionThreshold) {
+        QElapsedTimer timer;
+        timer.start();
+        compressed = MessageCodec::compressFrame(frame);
+        nanos = timer.nsecsElapsed();
+    }
+
+    const QByteArray& wire = compressed.isEmpty() ? frame : compressed;
+    m_webSocket->sendBinaryMessage(wire);
+
+    QMutexLocker locker(&m_statsMutex);
+    ++m_stats.framesOut;
+    m_stats.wireBytesOut += static_cast<quint64>(wire.size());
+    m_stats.payloadBytesOut += static_cast<quint64>(frame.size());
+    m_stats.compressNanos += static_cast<quint64>(nanos);
+    if (!compressed.isEmpty()) {
+        ++m_stats.compressedFramesOut;
+    }
+}
+
+void SocketWorker::countIn(qint64 wireBytes, qint64 payloadBytes, bool compressed, qint64 nanos)
+{
+    QMutexLocker locker(&m_statsMutex);
+    ++m_stats.framesIn;
+    m_stats.wireBytesIn += static_cast<quint64>(wireBytes);
+    m_stats.payloadBytesIn += static_cast<quint64>(payloadBytes);
+    m_stats.decompressNanos += static_cast<quint64>(nanos);
+    if (compressed) {
+        ++m_stats.compressedFramesIn;
+    }
+}
+
+WireStats SocketWorker::wireStats() const
+{
+    QMutexLocker locker(&m_statsMutex);
+    return m_stats;
+}
+
+void SocketWorker::resetWireStats()
+{
+    QMutexLocker locker(&m_statsMutex);
+    m_stats = WireStats();
+}
+
+void SocketWorker::onBytesWritten(qint64 bytes)
+{
+    Q_UNUSED(bytes);
+
+    if ((m_bufferFull && m_webSocket->bytesToWrite() < m_highWaterBytes / 2)
+        || (!m_bulkOutbox.empty() && m_webSocket->bytesToWrite() < m_bulkBufferLimit)) {
+        flushOutbox();
+    }
+}
+
+void SocketWorker::setBufferFull(bool full)
+{
+    if (m_bufferFull == full) {
+        return;
+    }
+
+    m_bufferFull = full;
+    if (full) {
+        qWarning() << "Send buffer full, queued:" << m_outbox.size()
+                   << "socket buffer:" << m_webSocket->bytesToWrite();
+        emit sendBufferFull();
+    } else {
+        emit sendBufferDrained();
+    }
+}
+
+void SocketWorker::clearOutbox()
+{
+    m_outbox.clear();
+    m_coalesceIndex.clear();
+    m_outboxBaseSeq = 0;
+    m_bulkOutbox.clear();
+    setBufferFull(false);
+}
+
+void SocketWorker::setSendQueueLimits(int maxMessages, qint64 highWaterBytes)
+{
+    m_maxQueuedMessages = qMax(1, maxMessages);
+    m_highWaterBytes = qMax<qint64>(1, highWaterBytes);
+}
+
+void SocketWorker::setBulkBufferLimit(qint64 bytes)
+{
+    m_bulkBufferLimit = qMax<qint64>(1, bytes);
+}
+
+void SocketWorker::setCompressionEnabled(bool enable)
+{
+    m_compressionEnabled = enable;
+    if (!enable) {
+        m_compressionActive = false;
+    } else if (m_isConnected) {
+        sendHello();
+    }
+}
+
+void SocketWorker::setCompressionThreshold(int bytes)
+{
+    m_compressionThreshold = qMax(1, bytes);
+}
+
+void SocketWorker::setBatchingEnabled(bool enable)
+{
+    m_batchingEnabled = enable;
+    if (!enable) {
+        m_batchSupported = false;
+    } else if (m_isConnected) {
+        sendHello();
+    }
+}
+
+void SocketWorker::setAutoReconnect(bool enable, int interval)
+{
+    m_autoReconnect = enable;
+    m_reconnectInterval = interval;
+}
+
+void SocketWorker::setPreferredWireFormat(WireFormat format)
+{
+    m_preferredFormat = format;
+
+    if (m_isConnected && m_preferredFormat != m_wireFormat) {
+        sendHello();
+    }
+}
+
+void SocketWorker::setModelDecoder(const std::string& msgType, ModelDecoder decoder)
+{
+    QMutexLocker locker(&m_decoderMutex);
+    if (decoder) {
+        m_decoders[msgType] = std::move(decoder);
+    } else {
+        m_decoders.erase(msgType);
+    }
+}
+
+void SocketWorker::setCompactEncoder(const std::string& msgType, CompactEncoder encoder)
+{
+    if (encoder) {
+        m_compactEncoders[msgType] = std::move(encoder);
+        if (m_isConnected) {
+            sendHello();
+        }
+    } else {
+        m_compactEncoders.erase(msgType);
+        m_compactTypes.erase(msgType);
+    }
+}
+
+void SocketWorker::sendHello()
+{
+    json formats = json::array();
+    if (m_preferredFormat != WireFormat::Json) {
+        formats.push_back(MessageCodec::formatName(m_preferredFormat).toStdString());
+    }
+    formats.push_back("json");
+
+    json hello = {
+        {"type", "sys.hello"},
+        {"formats", formats}
+    };
+    if (m_batchingEnabled) {
+        hello["batch"] = true;
+    }
+    if (m_compressionEnabled) {
+        hello["compression"] = json::array({"deflate"});
+        hello["compressionThreshold"] = m_compressionThreshold;
+    }
+    if (!m_compactEncoders.empty()) {
+        json compact = json::array();
+        for (const auto& entry : m_compactEncoders) {
+            compact.push_back(entry.first);
+        }
+        hello["compact"] = compact;
+    }
+
+    // 协商报文始终以 text JSON 发送，服务器无论是否支持都能解析
+    writeText(hello.dump());
+}
+
+bool SocketWorker::handleHello(const json& message)
+{
+    auto typeIt = message.find("type");
+    if (typeIt == message.end() || !typeIt->is_string() || *typeIt != "sys.hello") {
+        return false;
+    }
+
+    WireFormat format = WireFormat::Json;
+    auto formatIt = message.find("format");
+    if (formatIt != message.end() && formatIt->is_string()) {
+        if (!MessageCodec::formatFromName(formatIt->get<std::string>(), format)) {
+            qWarning() << "Server selected unknown wire format, falling back to JSON";
+            format = WireFormat::Json;
+        }
+    }
+
+    if (format != m_wireFormat) {
+        m_wireFormat = format;
+        qInfo() << "Wire format negotiated:" << MessageCodec::formatName(format);
+        emit wireFormatChanged(format);
+    }
+
+    auto batchIt = message.find("batch");
+    m_batchSupported = m_batchingEnabled && batchIt != message.end()
+        && batchIt->is_boolean() && batchIt->get<bool>();
+
+    auto compressionIt = message.find("compression");
+    const bool compression = m_compressionEnabled && compressionIt != message.end()
+        && compressionIt->is_string() && *compressionIt == "deflate";
+    if (compression != m_compressionActive) {
+        m_compressionActive = compression;
+        qInfo() << "Frame compression" << (compression ? "enabled" : "disabled");
+    }
+
+    // 只对服务器确认、且本端仍注册了编码器的类型发送紧凑格式
+    m_compactTypes.clear();
+    auto compactIt = message.find("compact");
+    if (compactIt != message.end() && compactIt->is_array()) {
+        for (const auto& type : *compactIt) {
+            if (type.is_string() && m_compactEncoders.count(type.get<std::string>()) != 0) {
+                m_compactTypes.insert(type.get<std::string>());
+            }
+        }
+    }
+    return true;
+}
+
+void SocketWorker::onConnected()
+{
+    m_isConnected = true;
+    ++m_connectionSerial;
+    stopAutoReconnectTimer();
+
+    qInfo() << "WebSocket connected";
+    if (m_preferredFormat != WireFormat::Json || m_batchingEnabled || m_compressionEnabled
+        || !m_compactEncoders.empty()) {
+        sendHello();
+    }
+    emit connected();
+
+    // 断线期间排队的消息
+    scheduleSendFlush();
+}
+
+void SocketWorker::onDisconnected()
+{
+    m_isConnected = false;
+    m_batchSupported = false;
+    m_compressionActive = false;
+    m_compactTypes.clear();
+    m_sendFlushScheduled = false;
+    m_bulkOutbox.clear();
+
+    // 重连后需要重新协商
+    if (m_wireFormat != WireFormat::Json) {
+        m_wireFormat = WireFormat::Json;
+        emit wireFormatChanged(m_wireFormat);
+    }
+
+    // 发件箱管理的消息重连后由上层重放，留在队列里会再发一次
+    const auto replayable = std::remove_if(m_outbox.begin(), m_outbox.end(),
+        [](const Outbound& item) { return item.replayable; });
+    if (replayable != m_outbox.end()) {
+        m_outbox.erase(replayable, m_outbox.end());
+        m_coalesceIndex.clear();
+        m_outboxBaseSeq = 0;
+        for (std::size_t i = 0; i < m_outbox.size(); ++i) {
+            if (!m_outbox[i].coalesceKey.empty()) {
+                m_coalesceIndex.emplace(m_outbox[i].coalesceKey, i);
+            }
+        }
+    }
+
+    qInfo() << "WebSocket disconnected";
+    emit disconnected();
+
+    // 套接字缓冲已随连接丢弃，队列中的其余消息等重连后再发
+    if (static_cast<int>(m_outbox.size()) < m_maxQueuedMessages) {
+        setBufferFull(false);
+    }
+
+    if (m_autoReconnect) {
+        startAutoReconnectTimer();
+    }
+}
+
+void SocketWorker::onError(QAbstractSocket::SocketError error)
+{
+    Q_UNUSED(error);
+    QString errorMsg = m_webSocket->errorString();
+    qCritical() << "WebSocket error:" << errorMsg;
+    emit this->error(errorMsg);
+}
+
+void SocketWorker::enqueueFrame(JsonDocPtr document)
+{
+    if (handleHello(*document)) {
+        return;
+    }
+
+    auto typeIt = document->find("type");
+    const bool hasType = typeIt != document->end() && typeIt->is_string();
+
+    // 批量信封拆成独立消息，订阅者看不到信封本身
+    if (hasType && *typeIt == "batch") {
+        auto messagesIt = document->find("messages");
+        if (messagesIt != document->end() && messagesIt->is_array()) {
+            for (const auto& item : *messagesIt) {
+                if (item.is_object()) {
+                    enqueueFrame(std::make_shared<const json>(item));
+                }
+            }
+        }
+        return;
+    }
+
+    DecodedFrame frame;
+
+    // 已注册解码器的类型在本线程构造业务模型，GUI 线程只负责分发
+    if (hasType) {
+        ModelDecoder decoder;
+        {
+            QMutexLocker locker(&m_decoderMutex);
+            auto it = m_decoders.find(typeIt->get_ref<const std::string&>());
+            if (it != m_decoders.end()) {
+                decoder = it->second;
+            }
+        }
+
+        if (decoder) {
+            try {
+                frame.model = decoder(*document);
+            } catch (const std::exception& e) {
+                qWarning() << "Model decoder failed:" << e.what();
+            }
+        }
+    }
+
+    frame.document = std::move(document);
+
+    // 同一轮事件循环内的消息合并为一批，减少跨线程投递次数
+    const bool scheduleFlush = m_pendingFrames.isEmpty();
+    m_pendingFrames.append(std::move(frame));
+    if (scheduleFlush) {
+        QMetaObject::invokeMethod(this, [this]() { flushFrames(); }, Qt::QueuedConnection);
+    }
+}
+
+void SocketWorker::flushFrames()
+{
+    if (m_pendingFrames.isEmpty()) {
+        return;
+    }
+
+    QVector<DecodedFrame> frames;
+    frames.swap(m_pendingFrames);
+    emit framesReady(frames);
+}
+
+void SocketWorker::onTextMessageReceived(const QString& message)
+{
+    // Qt5 的 text frame 只以 QString 交付，这里只做一次 UTF-16 -> UTF-8，
+    // 之后直接在这块字节上解析，失败时复用同一份数据转发
+    const QByteArray utf8 = message.toUtf8();
+    countIn(utf8.size(), utf8.size(), false, 0);
+
+    JsonDocPtr document = MessageCodec::parseUtf8(utf8.constData(), utf8.constData() + utf8.size());
+    if (!document) {
+        qWarning() << "Failed to parse JSON message";
+        emit error(QStringLiteral("JSON parse error"));
+
+        // 仍然转发原始数据
+        emit dataReceived(utf8);
+        return;
+    }
+
+    enqueueFrame(std::move(document));
+}
+
+void SocketWorker::onBinaryMessageReceived(const QByteArray& wireData)
+{
+    // 压缩帧先还原，之后与未压缩的帧走同一路径
+    QByteArray inflated;
+    const bool compressed = !wireData.isEmpty() && (static_cast<quint8>(wireData.at(0)) & MessageCodec::kCompressedFlag);
+    if (compressed && (m_wireFormat != WireFormat::Json || m_compressionActive)) {
+        QElapsedTimer timer;
+        timer.start();
+        if (!MessageCodec::decompressFrame(wireData, inflated)) {
+            qWarning() << "Failed to decompress binary frame";
+            emit error(QStringLiteral("Frame decompression error"));
+            return;
+        }
+        countIn(wireData.size(), inflated.size(), true, timer.nsecsElapsed());
+    } else {
+        countIn(wireData.size(), wireData.size(), false, 0);
+    }
+    const QByteArray& data = inflated.isEmpty() ? wireData : inflated;
+
+    // 文件分块在任何线路编码下都带 FrameTag::Chunk。text JSON 模式下 binary frame 原本都是原始数据，
+    // 只有帧头完整且 CRC 一致才当作分块，CRC 校验也在本线程完成
+    if (!data.isEmpty() && static_cast<quint8>(data.at(0)) == static_cast<quint8>(FrameTag::Chunk)) {
+        ChunkHeader header;
+        QByteArray payload;
+        if (MessageCodec::decodeChunk(data, header, payload)) {
+            emit chunkReceived(header, data);
+            return;
+        }
+        if (m_wireFormat != WireFormat::Json) {
+            qWarning() << "Dropping corrupt file chunk";
+            emit error(QStringLiteral("File chunk checksum mismatch"));
+            return;
+        }
+    }
+
+    if (!framesTagged()) {
+        emit dataReceived(data);
+        return;
+    }
+
+    try {
+        json jsonMessage;
+        FrameTag tag = FrameTag::Raw;
+        if (!MessageCodec::decode(data, jsonMessage, tag)) {
+            qWarning() << "Failed to decode binary frame";
+            emit error(QStringLiteral("Binary frame decode error"));
+            return;
+        }
+
+        if (tag == FrameTag::Raw) {
+            emit dataReceived(data.mid(1));
+            return;
+        }
+
+        enqueueFrame(std::make_shared<const json>(std::move(jsonMessage)));
+    } catch (const json::exception& e) {
+        qWarning() << "Failed to decode binary message:" << e.what();
+        emit error(QString("Binary decode error: %1").arg(e.what()));
+    }
+}
+
+void SocketWorker::startAutoReconnectTimer()
+{
+    if (m_reconnectTimerId == -1) {
+        qDebug() << "Starting auto-reconnect timer, interval:" << m_reconnectInterval << "ms";
+        m_reconnectTimerId = startTimer(m_reconnectInterval);
+    }
+}
+
+void SocketWorker::stopAutoReconnectTimer()
+{
+    if (m_reconnectTimerId != -1) {
+        killTimer(m_reconnectTimerId);
+        m_reconnectTimerId = -1;
+    }
+}
+
+void SocketWorker::timerEvent(QTimerEvent* event)
+{
+    if (event->timerId() == m_reconnectTimerId) {
+        qDebug() << "Auto-reconnecting...";
+        connectToServer(m_serverUrl);
+    } else {
+        QObject::timerEvent(event);
+    }
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+#include <QWebSocket>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "third_party/nlohmann_json/include/nlohmann/json.hpp"
+#include "messagecodec.h"
+
+using json = nlohmann::json;
+
+/**
+ * @brief 解码完成的一帧
+ */
+struct DecodedFrame
+{
+    JsonDocPtr document;     // 解析后的消息
+    DecodedModel model;      // 预解码的业务模型（未注册解码器时为空）
+};
+Q_DECLARE_METATYPE(DecodedFrame)
+
+/**
+ * @brief WebSocket 套接字工作对象
+ * 持有 QWebSocket，负责连接、重连、编码协商、帧编解码、发送队列和模型预解码。
+ * 由 WebSocketClient 创建：内联模式下与客户端同线程，
+ * 工作线程模式下被移到独立 QThread，所有调用都经排队连接进入
+ */
+class SocketWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SocketWorker(QObject* parent = nullptr);
+    ~SocketWorker() override;
+
+    void connectToServer(const QString& url);
+    void disconnectFromServer();
+    void sendMessage(const json& message, const std::string& coalesceKey = std::string());
+    void sendReplayableMessage(const json& message);
+    void sendRawData(const QByteArray& data);
+    void sendBulkData(const QByteArray& frame);
+    void setAutoReconnect(bool enable, int interval);
+    void setPreferredWireFormat(WireFormat format);
+    void setBatchingEnabled(bool enable);
+    void setSendQueueLimits(int maxMessages, qint64 highWaterBytes);
+    void setBulkBufferLimit(qint64 bytes);
+    void setCompressionEnabled(bool enable);
+    void setCompressionThreshold(int bytes);
+
+    /// 流量统计快照（任意线程可调用）
+    WireStats wireStats() const;
+    void resetWireStats();
+
+    /// 关闭连接并停止定时器（析构前在所属线程调用）
+    void shutdown();
+
+    /**
+     * @brief 注册模型解码器（任意线程可调用）
+     * 解码器在本对象所属线程执行
+     */
+    void setModelDecoder(const std::string& msgType, ModelDecoder decoder);
+
+    /**
+     * @brief 注册紧凑编码器（在本对象所属线程调用）
+     * 类型列表随 sys.hello 的 "compact" 声明，服务器确认后该类型的消息在写出前转换，否则按原样发送
+     */
+    void setCompactEncoder(const std::string& msgType, CompactEncoder encoder);
+
+signals:
+    void connected();
+    void disconnected();
+    void error(const QString& errorMsg);
+
+    /// 本轮事件循环内解码完成的消息，批量交付
+    void framesReady(const QVector<DecodedFrame>& frames);
+
+    /// 接收到原始数据
+    void dataReceived(const QByteArray& data);
+
+    /// 接收到 CRC 校验通过的文件分块；frame 为整帧（不复制），数据从 MessageCodec::kChunkHeaderSize 开始
+    void chunkReceived(const ChunkHeader& header, const QByteArray& frame);
+
+    /// 线路编码协商结果改变
+    void wireFormatChanged(WireFormat format);
+
+    /// 发送缓冲超过高水位或队列已满
+    void sendBufferFull();
+
+    /// 发送缓冲回落到低水位以下
+    void sendBufferDrained();
+
+protected:
+    void timerEvent(QTimerEvent* event) override;
+
+private slots:
+    void onConnected();
+    void onDisconnected();
+    void onError(QAbstractSocket::SocketError error);
+    void onTextMessageReceived(const QString& message);
+    void onBinaryMessageReceived(const QByteArray& data);
+    void onBytesWritten(qint64 bytes);
+
+private:
+    /// 发送队列中的一项：JSON 消息或原始数据
+    struct Outbound
+    {
+        json message;
+        QByteArray raw;
+        bool isRaw = false;
+        bool replayable = false;    // 由上层发件箱重放，断线时丢弃
+        std::string coalesceKey;
+    };
+
+    void startAutoReconnectTimer();
+    void stopAutoReconnectTimer();
+    void sendHello();
+    bool handleHello(const json& message);
+    void enqueueFrame(JsonDocPtr document);
+    void flushFrames();
+    void enqueueOutbound(Outbound item);
+    void scheduleSendFlush();
+    void flushOutbox();
+    void encodeCompact(json& message) const;
+    void writeMessage(const json& message);
+    void writeText(const std::string& text);
+    void writeBinary(const QByteArray& frame, bool compressible);
+    bool framesTagged() const { return m_wireFormat != WireFormat::Json || m_compressionActive; }
+    void countIn(qint64 wireBytes, qint64 payloadBytes, bool compressed, qint64 nanos);
+    void setBufferFull(bool full);
+    void clearOutbox();
+
+    QWebSocket* m_webSocket = nullptr;
+    QString m_serverUrl;
+    bool m_isConnected = false;
+    bool m_autoReconnect = false;
+    int m_reconnectInterval = 5000;
+    int m_reconnectTimerId = -1;
+    WireFormat m_preferredFormat = WireFormat::Json;
+    WireFormat m_wireFormat = WireFormat::Json;
+    bool m_batchingEnabled = false;     // 本端是否请求批量信封
+    bool m_batchSupported = false;      // 服务器是否接受批量信封
+    bool m_compressionEnabled = false;  // 本端是否请求压缩
+    bool m_compressionActive = false;   // 服务器同意 deflate
+    int m_compressionThreshold = 512;   // 小于该字节数的帧不压缩（心跳、输入状态等）
+    quint64 m_connectionSerial = 0;     // 每建立一次连接加一，传给紧凑编码器
+
+    mutable QMutex m_statsMutex;
+    WireStats m_stats;
+
+    QVector<DecodedFrame> m_pendingFrames;
+
+    // 发送队列：断线期间暂存，套接字缓冲超过高水位时暂停写入
+    std::deque<Outbound> m_outbox;
+    std::unordered_map<std::string, quint64> m_coalesceIndex;   // 合并键 -> 队列序号
+    quint64 m_outboxBaseSeq = 0;        // m_outbox.front() 的序号
+    int m_maxQueuedMessages = 1000;
+    qint64 m_highWaterBytes = 1024 * 1024;
+    bool m_bufferFull = false;
+    bool m_sendFlushScheduled = false;
+
+    // 低优先级队列（文件分块）：普通队列为空且套接字待写字节低于 m_bulkBufferLimit 时才写出，
+    // 聊天消息最多排在这么多分块数据之后。断线时丢弃，由上层从已确认的偏移续传
+    std::deque<QByteArray> m_bulkOutbox;
+    qint64 m_bulkBufferLimit = 256 * 1024;
+
+    QMutex m_decoderMutex;
+    std::unordered_map<std::string, ModelDecoder> m_decoders;
+
+    // 紧凑编码器只在本线程访问；m_compactTypes 为服务器本次连接确认过的类型
+    std::unordered_map<std::string, CompactEncoder> m_compactEncoders;
+    std::unordered_set<std::string> m_compactTypes;
+};
@@ -1,87 +1,129 @@
 #include "WebSocketClient.h"
+#include "MessageDispatcher.h"
+#include "SocketWorker.h"
 #include <QDebug>
-#include <QTimer>
-#include <QTimerEvent>
-#include <QUrl>
 
-WebSocketClient::WebSocketClient(QObject* parent)
+WebSocketClient::WebSocketClient(QObject* parent, ThreadMode mode)
     : QObject(parent)
-    , m_webSocket(std::make_unique<QWebSocket>())
-{
+    , m_threadMode(mode)
+    , m_dispatcher(new MessageDispatcher(this))
+{
+    qRegisterMetaType<JsonDocPtr>("JsonDocPtr");
+    qRegisterMetaType<WireFormat>("WireFormat");
+    qRegisterMetaType<ChunkHeader>("ChunkHeader");
+    qRegisterMetaType<WireStats>("WireStats");
+    qRegisterMetaType<DecodedFrame>("DecodedFrame");
+    qRegisterMetaType<QVector<DecodedFrame>>("QVector<DecodedFrame>");
+    
+    if (m_threadMode == ThreadMode::Worker) {
+        // 工作对象没有父对象，才能移到网络线程；由析构函数负责释放
+        m_worker = new SocketWorker();
+        m_thread = new QThread(this);
+        m_thread->setObjectName(QStringLiteral("WebSocketWorker"));
+        m_worker->moveToThread(m_thread);
+        m_thread->start();
+    } else {
+        m_worker = new SocketWorker(this);
+    }
+    
     setupConnections();
 }
 
 WebSocketClient::~WebSocketClient()
 {
-    if (m_webSocket) {
-        m_webSocket->close();
+    if (m_threadMode == ThreadMode::Worker) {
+        // 套接字和定时器属于网络线程，必须在该线程内关闭
+        QMetaObject::invokeMethod(m_worker, [worker = m_worker]() { worker->shutdown(); },
+                                  Qt::BlockingQueuedConnection);
+        m_thread->quit();
+        m_thread->wait();
+        delete m_worker;
+    } else {
+        m_worker->shutdown();
     }
+    m_worker = nullptr;
 }
 
 void WebSocketClient::setupConnections()
 {
-    connect(m_webSocket.get(), &QWebSocket::connected, 
-            this, &WebSocketClient::onConnected);
+    // 工作线程模式下以下连接均为排队连接，槽在客户端所属线程执行
+    connect(m_worker, &SocketWorker::connected, 
+            this, &WebSocketClient::onWorkerConnected);
+    
+    connect(m_worker, &SocketWorker::disconnected, 
+            this, &WebSocketClient::onWorkerDisconnected);
+    
+    connect(m_worker, &SocketWorker::error, 
+            this, &WebSocketClient::error);
+    
+    connect(m_worker, &SocketWorker::dataReceived, 
+            this, &WebSocketClient::dataReceived);
+    
+    connect(m_worker, &SocketWorker::chunkReceived, 
+            this, &WebSocketClient::chunkReceived);
     
-    connect(m_webSocket.get(), &QWebSocket::disconnected, 
-            this, &WebSocketClient::onDisconnected);
+    connect(m_worker, &SocketWorker::wireFormatChanged, 
+            this, &WebSocketClient::onWireFormatChanged);
     
-    connect(m_webSocket.get(), 
-            static_cast<void(QWebSocket::*)(QAbstractSocket::SocketError)>(&QWebSocket::error),
-            this, &WebSocketClient::onError);
+    connect(m_worker, &SocketWorker::framesReady, 
+            this, &WebSocketClient::onFramesReady);
     
-    connect(m_webSocket.get(), &QWebSocket::textMessageReceived, 
-            this, &WebSocketClient::onTextMessageReceived);
+    connect(m_worker, &SocketWorker::sendBufferFull, 
+            this, &WebSocketClient::onSendBufferFull);
     
-    connect(m_webSocket.get(), &QWebSocket::binaryMessageReceived, 
-            this, &WebSocketClient::onBinaryMessageReceived);
+    connect(m_worker, &SocketWorker::sendBufferDrained, 
+            this, &WebSocketClient::onSendBufferDrained);
 }
 
-void WebSocketClient::connectToServer(const QString& url)
+void WebSocketClient::invokeWorker(std::function<void()> fn)
 {
-    m_serverUrl = url;
-    
-    if (m_webSocket->isValid()) {
-        m_webSocket->close();
+    if (m_threadMode == ThreadMode::Inline) {
+        fn();
+        return;
     }
     
-    qDebug() << "Connecting to WebSocket server:" << url;
-    m_webSocket->open(QUrl(url));
+    QMetaObject::invokeMethod(m_worker, std::move(fn), Qt::QueuedConnection);
+}
+
+void WebSocketClient::connectToServer(const QString& url)
+{
+    invokeWorker([worker = m_worker, url]() { worker->connectToServer(url); });
 }
 
 void WebSocketClient::disconnect()
 {
-    stopAutoReconnectTimer();
-    
-    if (m_webSocket && m_webSocket->isValid()) {
-        m_webSocket->close();
-    }
+    invokeWorker([worker = m_worker]() { worker->disconnectFromServer(); });
 }
 
-void WebSocketClient::sendMessage(const json& message)
+void WebSocketClient::sendMessage(const json& message, const std::string& coalesceKey)
 {
-    if (!m_isConnected) {
-        qWarning() << "WebSocket not connected, cannot send message";
+    if (m_threadMode == ThreadMode::Inline) {
+        m_worker->sendMessage(message, coalesceKey);
         return;
     }
     
-    try {
-        QString jsonStr = QString::fromStdString(message.dump());
-        m_webSocket->sendTextMessage(jsonStr);
-    } catch (const std::exception& e) {
-        qCritical() << "Failed to send message:" << e.what();
-        emit error(QString::fromStdString(e.what()));
-    }
+    // 跨线程时必须复制一份，调用方的 json 在返回后可能被修改或释放
+    invokeWorker([worker = m_worker, message, coalesceKey]() { worker->sendMessage(message, coalesceKey); });
 }
 
-void WebSocketClient::sendRawData(const QByteArray& data)
+void WebSocketClient::sendReplayableMessage(const json& message)
 {
-    if (!m_isConnected) {
-        qWarning() << "WebSocket not connected, cannot send data";
+    if (m_threadMode == ThreadMode::Inline) {
+        m_worker->sendReplayableMessage(message);
         return;
     }
     
-    m_webSocket->sendBinaryMessage(data);
+    invokeWorker([worker = m_worker, message]() { worker->sendReplayableMessage(message); });
+}
+
+void WebSocketClient::sendRawData(const QByteArray& data)
+{
+    invokeWorker([worker = m_worker, data]() { worker->sendRawData(data); });
+}
+
+void WebSocketClient::sendBulkData(const QByteArray& frame)
+{
+    invokeWorker([worker = m_worker, frame]() { worker->sendBulkData(frame); });
 }
 
 bool WebSocketClient::isConnected() const
@@ -91,86 +133,102 @@ bool WebSocketClient::isConnected() const
 
 void WebSocketClient::setAutoReconnect(bool enable, int interval)
 {
-    m_autoReconnect = enable;
-    m_reconnectInterval = interval;
+    invokeWorker([worker = m_worker, enable, interval]() { worker->setAutoReconnect(enable, interval); });
 }
 
-void WebSocketClient::onConnected()
+void WebSocketClient::setPreferredWireFormat(WireFormat format)
 {
-    m_isConnected = true;
-    stopAutoReconnectTimer();
-    
-    qInfo() << "WebSocket connected";
-    emit connected();
-    emit connectionStateChanged(true);
+    invokeWorker([worker = m_worker, format]() { worker->setPreferredWireFormat(format); });
 }
 
-void WebSocketClient::onDisconnected()
+void WebSocketClient::setBatchingEnabled(bool enable)
 {
-    m_isConnected = false;
-    
-    qInfo() << "WebSocket disconnected";
-    emit disconnected();
-    emit connectionStateChanged(false);
-    
-    if (m_autoReconnect) {
-        startAutoReconnectTimer();
-    }
+    invokeWorker([worker = m_worker, enable]() { worker->setBatchingEnabled(enable); });
 }
 
-void WebSocketClient::onError(QAbstractSocket::SocketError error)
+void WebSocketClient::setSendQueueLimits(int maxMessages, qint64 highWaterBytes)
 {
-    QString errorMsg = m_webSocket->errorString();
-    qCritical() << "WebSocket error:" << errorMsg;
-    emit this->error(errorMsg);
+    invokeWorker([worker = m_worker, maxMessages, highWaterBytes]() {
+        worker->setSendQueueLimits(maxMessages, highWaterBytes);
+    });
 }
 
-void WebSocketClient::onTextMessageReceived(const QString& message)
+void WebSocketClient::setBulkBufferLimit(qint64 bytes)
 {
-    try {
-        json jsonMessage = json::parse(message.toStdString());
-        emit messageReceived(jsonMessage);
-    } catch (const json::exception& e) {
-        qWarning() << "Failed to parse JSON message:" << e.what();
-        emit error(QString("JSON parse error: %1").arg(e.what()));
-        
-        // 仍然转发原始数据
-        emit dataReceived(message.toUtf8());
-    }
+    invokeWorker([worker = m_worker, bytes]() { worker->setBulkBufferLimit(bytes); });
 }
 
-void WebSocketClient::onBinaryMessageReceived(const QByteArray& data)
+void WebSocketClient::setCompressionEnabled(bool enable)
 {
-    emit dataReceived(data);
+    invokeWorker([worker = m_worker, enable]() { worker->setCompressionEnabled(enable); });
 }
 
-void WebSocketClient::startAutoReconnectTimer()
+void WebSocketClient::setCompressionThreshold(int bytes)
 {
-    if (m_reconnectTimerId == -1) {
-        qDebug() << "Starting auto-reconnect timer, interval:" << m_reconnectInterval << "ms";
-        m_reconnectTimerId = startTimer(m_reconnectInterval);
-    }
+    invokeWorker([worker = m_worker, bytes]() { worker->setCompressionThreshold(bytes); });
 }
 
-void WebSocketClient::stopAutoReconnectTimer()
+WireStats WebSocketClient::wireStats() const
 {
-    if (m_reconnectTimerId != -1) {
-        killTimer(m_reconnectTimerId);
-        m_reconnectTimerId = -1;
-    }
+    // 统计自带锁，直接读取
+    return m_worker->wireStats();
 }
 
-void WebSocketClient::timerEvent(QTimerEvent* event)
+void WebSocketClient::resetWireStats()
 {
-    if (event->timerId() == m_reconnectTimerId) {
-        onAutoReconnectTimeout();
-    } else {
-        QObject::timerEvent(event);
-    }
+    m_worker->resetWireStats();
+}
+
+void WebSocketClient::setModelDecoder(const std::string& msgType, ModelDecoder decoder)
+{
+    // 解码器表自带锁，直接写入即可
+    m_worker->setModelDecoder(msgType, std::move(decoder));
+}
+
+void WebSocketClient::setCompactEncoder(const std::string& msgType, CompactEncoder encoder)
+{
+    invokeWorker([worker = m_worker, msgType, encoder]() { worker->setCompactEncoder(msgType, encoder); });
+}
+
+void WebSocketClient::onWorkerConnected()
+{
+    m_isConnected = true;
+    emit connected();
+    emit connectionStateChanged(true);
+}
+
+void WebSocketClient::onWorkerDisconnected()
+{
+    m_isConnected = false;
+    emit disconnected();
+    emit connectionStateChanged(false);
+}
+
+void WebSocketClient::onWireFormatChanged(WireFormat format)
+{
+    m_wireFormat = format;
+    emit wireFormatChanged(format);
 }
 
-void WebSocketClient::onAutoReconnectTimeout()
+void WebSocketClient::onSendBufferFull()
 {
-    qDebug() << "Auto-reconnecting...";
-    connectToServer(m_serverUrl);
+    m_sendBufferFull = true;
+    emit sendBufferFull();
+}
+
+void WebSocketClient::onSendBufferDrained()
+{
+    m_sendBufferFull = false;
+    emit sendBufferDrained();
+}
+
+void WebSocketClient::onFramesReady(const QVector<DecodedFrame>& frames)
+{
+    for (const DecodedFrame& frame : frames) {
+        // 按优先级通道排队，本轮收到的帧中 ack / 控制消息先于大批量回复处理
+        m_dispatcher->post(frame.document, frame.model);
+        
+        emit documentReceived(frame.document);
+        emit messageReceived(*frame.document);
+    }
 }
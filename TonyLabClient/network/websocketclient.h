@@ -1,24 +1,46 @@
 #pragma once
 
 #include <QObject>
-#include <QWebSocket>
-#include <memory>
+#include <QThread>
+#include <QVector>
+#include <functional>
+#include <string>
 #include "third_party/nlohmann_json/include/nlohmann/json.hpp"
+#include "messagecodec.h"
 
 using json = nlohmann::json;
 
+class MessageDispatcher;
+class SocketWorker;
+struct DecodedFrame;
+
 /**
  * @brief WebSocket 通信客户端
  * 负责 WebSocket 连接、发送和接收消息
+ * 套接字、帧编解码与模型预解码由 SocketWorker 完成：
+ * Inline 模式下与客户端同线程；Worker 模式下运行在独立网络线程，
+ * GUI 线程只接收成批的已解码消息并分发。对外接口在两种模式下一致，只能在客户端所属线程调用
  */
 class WebSocketClient : public QObject
 {
     Q_OBJECT
     
 public:
-    explicit WebSocketClient(QObject* parent = nullptr);
+    /// 套接字运行位置
+    enum class ThreadMode
+    {
+        Inline,     // 与客户端同线程
+        Worker      // 独立网络线程
+    };
+    
+    explicit WebSocketClient(QObject* parent = nullptr, ThreadMode mode = ThreadMode::Inline);
     ~WebSocketClient();
     
+    /**
+     * @brief 当前线程模式
+     */
+    ThreadMode threadMode() const { return m_threadMode; }
+    
     /**
      * @brief 连接到服务器
      * @param url WebSocket 服务器地址（如 ws://localhost:8080）
@@ -32,9 +54,19 @@ public:
     
     /**
      * @brief 发送 JSON 消息
+     * 消息先进入发送队列：未连接时暂存到重连，套接字缓冲超过高水位时暂停写出。
+     * 队列中尚未发出的同键消息会被新消息原位替换（im.typing 默认按 targetId 合并）
      * @param message JSON 对象
+     * @param coalesceKey 合并键，为空时按消息类型推断
+     */
+    void sendMessage(const json& message, const std::string& coalesceKey = std::string());
+    
+    /**
+     * @brief 发送由上层负责重发的消息（如 ChatService 发件箱中的聊天消息和文件元数据，以及 im.history 请求）
+     * 与 sendMessage 相同，但未连接时不入队，断线时尚未写出的部分从队列丢弃：
+     * 重连后由上层统一重放或重新请求，同一条消息不会发两次
      */
-    void sendMessage(const json& message);
+    void sendReplayableMessage(const json& message);
     
     /**
      * @brief 发送原始数据
@@ -42,11 +74,25 @@ public:
      */
     void sendRawData(const QByteArray& data);
     
+    /**
+     * @brief 发送低优先级二进制帧（文件分块，见 MessageCodec::encodeChunk）
+     * 帧原样写出，不加前缀。只在普通发送队列为空、套接字待写字节低于分块缓冲上限时写出，
+     * 聊天消息不会排在大量分块之后。未连接时直接丢弃，断线时丢弃尚未写出的分块
+     */
+    void sendBulkData(const QByteArray& frame);
+    
     /**
      * @brief 是否已连接
      */
     bool isConnected() const;
     
+    /**
+     * @brief 消息分发器
+     * 每条收到的消息都会经过它路由一次，业务服务在这里注册处理器，
+     * 不要再各自监听 messageReceived 并比较 type 字符串
+     */
+    MessageDispatcher* dispatcher() const { return m_dispatcher; }
+    
     /**
      * @brief 设置自动重连
      * @param enable 是否启用
@@ -54,6 +100,76 @@ public:
      */
     void setAutoReconnect(bool enable, int interval = 5000);
     
+    /**
+     * @brief 设置首选线路编码
+     * 连接建立后通过 sys.hello 与服务器协商，服务器不支持时回退为 text JSON
+     * @param format 首选格式（Json 表示不协商）
+     */
+    void setPreferredWireFormat(WireFormat format);
+    
+    /**
+     * @brief 当前生效的线路编码
+     */
+    WireFormat wireFormat() const { return m_wireFormat; }
+    
+    /**
+     * @brief 注册消息模型解码器
+     * 解码器在网络线程上把 json 转为业务模型，随消息一起交给分发器，
+     * 处理器内用 MessageDispatcher::currentModel<T>() 取出。
+     * 解码器必须是无副作用的纯函数（不访问 GUI 对象和服务状态）
+     * @param msgType 消息类型
+     * @param decoder 解码函数，传空函数表示移除
+     */
+    void setModelDecoder(const std::string& msgType, ModelDecoder decoder);
+    
+    /**
+     * @brief 注册紧凑编码器
+     * 连接建立时在 sys.hello 中以 "compact": [类型…] 声明，服务器回复中同样列出该类型后，
+     * 该类型的消息在网络线程写出前经编码器转换；服务器未确认时按完整格式发送。
+     * 编码器在网络线程执行，不要访问 GUI 对象和服务状态
+     * @param msgType 消息类型
+     * @param encoder 编码函数，传空函数表示移除
+     */
+    void setCompactEncoder(const std::string& msgType, CompactEncoder encoder);
+    
+    /**
+     * @brief 启用批量信封
+     * 在 sys.hello 中声明 "batch": true，服务器同样回复 "batch": true 后，
+     * 同一轮事件循环内排队的多条 JSON 消息合并为一个 {"type":"batch","messages":[...]} 帧发送
+     */
+    void setBatchingEnabled(bool enable);
+    
+    /**
+     * @brief 设置发送队列上限
+     * @param maxMessages 队列最多暂存的消息数，超出时丢弃新消息并发出 error
+     * @param highWaterBytes 套接字待写字节数高水位，超过时暂停写出并发出 sendBufferFull
+     */
+    void setSendQueueLimits(int maxMessages, qint64 highWaterBytes);
+    
+    /**
+     * @brief 设置分块缓冲上限
+     * 套接字待写字节不低于该值时暂停写出分块（默认 256 KB），决定聊天消息最多排在多少分块数据之后
+     */
+    void setBulkBufferLimit(qint64 bytes);
+    
+    /**
+     * @brief 启用帧压缩（在 sys.hello 中协商 deflate，服务器不支持时照常不压缩）
+     * 只压缩不小于阈值的消息帧，原始数据与文件分块不压缩
+     */
+    void setCompressionEnabled(bool enable);
+    void setCompressionThreshold(int bytes);
+    
+    /**
+     * @brief 线路字节与压缩耗时统计（可在任意线程调用）
+     */
+    WireStats wireStats() const;
+    void resetWireStats();
+    
+    /**
+     * @brief 发送缓冲是否已满（sendBufferFull 与 sendBufferDrained 之间）
+     */
+    bool isSendBufferFull() const { return m_sendBufferFull; }
+    
 signals:
     /// 连接成功
     void connected();
@@ -64,35 +180,52 @@ signals:
     /// 连接出错
     void error(const QString& errorMsg);
     
-    /// 接收到 JSON 消息
+    /// 接收到 JSON 消息（共享只读文档，订阅者可直接持有，无需复制）
+    void documentReceived(const JsonDocPtr& document);
+    
+    /// 接收到 JSON 消息（兼容旧接口，引用 documentReceived 中的同一份文档）
     void messageReceived(const json& message);
     
     /// 接收到原始数据
     void dataReceived(const QByteArray& data);
     
+    /**
+     * @brief 接收到文件分块（帧头已解析、CRC 已在网络线程校验）
+     * @param frame 整帧，数据从 MessageCodec::kChunkHeaderSize 开始
+     */
+    void chunkReceived(const ChunkHeader& header, const QByteArray& frame);
+    
     /// 连接状态改变
     void connectionStateChanged(bool connected);
     
+    /// 线路编码协商结果改变
+    void wireFormatChanged(WireFormat format);
+    
+    /// 发送缓冲超过高水位或队列已满，调用方应暂停非必要的发送
+    void sendBufferFull();
+    
+    /// 发送缓冲回落到高水位一半以下
+    void sendBufferDrained();
+    
 private slots:
-    void onConnected();
-    void onDisconnected();
-    void onError(QAbstractSocket::SocketError error);
-    void onTextMessageReceived(const QString& message);
-    void onBinaryMessageReceived(const QByteArray& data);
-    void onAutoReconnectTimeout();
+    void onWorkerConnected();
+    void onWorkerDisconnected();
+    void onWireFormatChanged(WireFormat format);
+    void onSendBufferFull();
+    void onSendBufferDrained();
+    void onFramesReady(const QVector<DecodedFrame>& frames);
     
 private:
     void setupConnections();
-    void startAutoReconnectTimer();
-    void stopAutoReconnectTimer();
     
-    // Timer event for auto-reconnect
-    void timerEvent(QTimerEvent* event) override;
+    /// 在工作对象所属线程执行调用（Inline 模式直接调用）
+    void invokeWorker(std::function<void()> fn);
     
-    std::unique_ptr<QWebSocket> m_webSocket;
-    QString m_serverUrl;
+    ThreadMode m_threadMode = ThreadMode::Inline;
+    SocketWorker* m_worker = nullptr;
+    QThread* m_thread = nullptr;
+    MessageDispatcher* m_dispatcher = nullptr;
     bool m_isConnected = false;
-    bool m_autoReconnect = false;
-    int m_reconnectInterval = 5000;
-    int m_reconnectTimerId = -1;
+    bool m_sendBufferFull = false;
+    WireFormat m_wireFormat = WireFormat::Json;
 };
@@ -2,6 +2,7 @@
 
 #include "modules/chat/chatservice.h"
 #include "modules/chat/contactservice.h"
+#include "modules/chat/frienddetailloader.h"
 #include "modules/chat/msgpane.h"
 #include "modules/chat/navpane.h"
 
@@ -58,7 +59,26 @@ void WeComWnd::initServices()
     m_chatService = new ChatService(m_wsClient, this);
     m_contactService = new ContactService(m_wsClient, this);
 
+    // Compact im.message omits the sender profile; receivers fill it from the friend list,
+    // which FriendDetailLoader keeps up to date.
+    m_chatService->setCompactMessages(true);
+    m_chatService->setProfileResolver([msg = m_msg](const QString& userId, QString& name, QString& avatar) {
+        bool ok = false;
+        const int id = userId.toInt(&ok);
+        FRIENDINFO info;
+        if (!ok || !msg->findFriend(id, info)) {
+            return false;
+        }
+        name = info.name;
+        avatar = info.img;
+        return true;
+    });
+
+    m_detailLoader = new FriendDetailLoader(m_wsClient, this);
+
     m_msg->setChatService(m_chatService);
+    connect(m_detailLoader, &FriendDetailLoader::detailsLoaded, m_msg, &MsgPane::updateFriendDetails);
+    connect(m_msg, &MsgPane::visibleFriendsChanged, m_detailLoader, &FriendDetailLoader::prioritize);
 }
 
 void WeComWnd::setUserDetail(int userId, const QString& userName, const QString& userImg, const QString& userEmail, const QString& userPart)
@@ -84,3 +104,10 @@ void WeComWnd::setFriendList(const QVector<FRIENDINFO>& friends)
         m_msg->setFriendList(friends);
     }
 }
+
+void WeComWnd::loadFriendDetails(const QVector<int>& friendIds)
+{
+    if (m_detailLoader) {
+        m_detailLoader->start(QString::number(m_userId), friendIds);
+    }
+}
@@ -8,6 +8,7 @@
 class WebSocketClient;
 class ChatService;
 class ContactService;
+class FriendDetailLoader;
 class NavPane;
 class MsgPane;
 
@@ -21,6 +22,8 @@ public:
 
     void setUserDetail(int userId, const QString& userName, const QString& userImg, const QString& userEmail, const QString& userPart);
     void setFriendList(const QVector<FRIENDINFO>& friends);
+    // Fetch details for all friends in the background; visible rows go first.
+    void loadFriendDetails(const QVector<int>& friendIds);
 
 private:
     void initUi();
@@ -35,6 +38,7 @@ private:
     WebSocketClient* m_wsClient = nullptr;
     ChatService* m_chatService = nullptr;
     ContactService* m_contactService = nullptr;
+    FriendDetailLoader* m_detailLoader = nullptr;
 
     NavPane* m_nav = nullptr;
     MsgPane* m_msg = nullptr;